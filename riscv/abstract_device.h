@@ -5,6 +5,7 @@
 #include "common.h"
 #include <cstdint>
 #include <cstddef>
+#include <iosfwd>
 #include <string>
 #include <map>
 #include <stdexcept>
@@ -19,6 +20,9 @@ class abstract_device_t {
   virtual reg_t size() = 0;
   virtual ~abstract_device_t() {}
   virtual void tick(reg_t UNUSED rtc_ticks) {}
+  // Save and restore the device state in checkpoints (see checkpoint.h)
+  virtual void save_state(std::ostream UNUSED &o) {}
+  virtual void restore_state(std::istream UNUSED &i) {}
 };
 
 // factory for devices which should show up in the DTS, and can be
@@ -0,0 +1,68 @@
+#include "decode.h"
+#include "decode_tree.h"
+#include "common.h"
+#include <vector>
+#include <string>
+#include <cstdio>
+
+// Checks that insn_decode_tree_t finds the same instruction as a linear
+// search for the first matching mask/match pair.
+
+static size_t linear_lookup(const std::vector<insn_decode_tree_t::pattern_t>& patterns, insn_bits_t bits)
+{
+  for (size_t i = 0; i < patterns.size(); i++)
+    if ((bits & patterns[i].mask) == patterns[i].match)
+      return i;
+  return patterns.size();
+}
+
+int main()
+{
+  #define DECLARE_INSN(name, match, mask) \
+    const insn_bits_t UNUSED name##_match = (match), name##_mask = (mask);
+    #include "encoding.h"
+  #undef DECLARE_INSN
+
+  static const char* names[] = {
+    #define DEFINE_INSN(name) #name,
+      #include "insn_list.h"
+    #undef DEFINE_INSN
+  };
+
+  // Instructions in list order, which includes overlapping encodings
+  std::vector<insn_decode_tree_t::pattern_t> patterns = {
+    #define DEFINE_INSN(name) {name##_mask, name##_match},
+      #include "insn_list.h"
+    #undef DEFINE_INSN
+  };
+
+  insn_decode_tree_t tree;
+  tree.build(patterns);
+
+  bool ok = true;
+  uint64_t seed = 1;
+  auto random = [&]() {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed >> 32;
+  };
+  auto check = [&](insn_bits_t bits) {
+    size_t expected = linear_lookup(patterns, bits), found = tree.lookup(bits);
+    if (expected != found) {
+      fprintf(stderr, "Decoding %08" PRIx64 " found %s instead of %s\n", bits,
+              found < patterns.size() ? names[found] : "nothing",
+              expected < patterns.size() ? names[expected] : "nothing");
+      ok = false;
+    }
+  };
+
+  // Each instruction with random operand fields, then random bits
+  for (const auto& p : patterns)
+    for (int i = 0; i < 16; i++)
+      check(p.match | (random() & ~p.mask & 0xffffffff));
+  for (int i = 0; i < 1000000; i++)
+    check(random());
+  for (int i = 0; i < 65536; i++)
+    check(i);
+
+  return ok ? 0 : -1;
+}
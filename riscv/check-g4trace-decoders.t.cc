@@ -0,0 +1,76 @@
+#include "decode.h"
+#include "common.h"
+#include <unordered_set>
+#include <string>
+#include <cstdio>
+
+// Checks that g4trace_insns.h does not miss any instruction that g4trace
+// must not trace as UNKNOWN: loads, stores, atomics and control transfers.
+
+struct opcode {
+  insn_bits_t match;
+  std::string name;
+};
+
+static bool accesses_memory_or_pc(insn_bits_t match)
+{
+  if ((match & 0x3) == 0x3) {
+    switch (match & 0x7f) {
+      case 0x03: // LOAD
+      case 0x07: // LOAD-FP and vector loads
+      case 0x23: // STORE
+      case 0x27: // STORE-FP and vector stores
+      case 0x2f: // AMO
+      case 0x63: // BRANCH
+      case 0x67: // JALR
+      case 0x6f: // JAL
+        return true;
+      default:
+        return false;
+    }
+  }
+  // compressed loads, stores, jumps and branches (and Zcmp/Zcmt); c.jr and
+  // c.jalr share their funct3 with c.mv, c.add and c.ebreak and are not checked
+  int quadrant = match & 0x3;
+  int funct3 = (match >> 13) & 0x7;
+  return (quadrant == 0 && funct3 != 0)
+    || (quadrant == 1 && (funct3 == 1 || funct3 >= 5))
+    || (quadrant == 2 && funct3 != 0 && funct3 != 4);
+}
+
+int main()
+{
+  #define DECLARE_INSN(name, match, mask) \
+    const insn_bits_t UNUSED name##_match = (match);
+    #include "encoding.h"
+  #undef DECLARE_INSN
+
+  static const opcode static_list[] = {
+    #define DEFINE_INSN(name) \
+      {name##_match, #name},
+      #include "insn_list.h"
+    #undef DEFINE_INSN
+  };
+
+  bool ok = true;
+
+  // Naming an instruction that does not exist fails to compile here.
+  std::unordered_set<std::string> traced;
+  #define G4TRACE_INSN(name, decoder) \
+    if (!traced.insert(#name).second) { \
+      fprintf(stderr, "Instruction %s is listed twice in g4trace_insns.h\n", #name); \
+      ok = false; \
+    } \
+    (void) name##_match;
+    #include "g4trace_insns.h"
+  #undef G4TRACE_INSN
+
+  for (const auto& op : static_list) {
+    if (accesses_memory_or_pc(op.match) && !traced.count(op.name)) {
+      fprintf(stderr, "Instruction %s has no g4trace decoder in g4trace_insns.h\n", op.name.c_str());
+      ok = false;
+    }
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+// See LICENSE for license details.
+#ifndef _RISCV_CHECKPOINT_H
+#define _RISCV_CHECKPOINT_H
+
+// Helpers to save and restore simulator state (--g4trace-checkpoint-at-roi and
+// --restore). A checkpoint is only meant to be restored by the same spike
+// binary with the same configuration, so values are stored in host format.
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+inline void checkpoint_put_bytes(std::ostream& o, const void* data, size_t len)
+{
+  o.write(static_cast<const char*>(data), len);
+}
+
+inline void checkpoint_get_bytes(std::istream& i, void* data, size_t len)
+{
+  if (!i.read(static_cast<char*>(data), len))
+    throw std::runtime_error("checkpoint is truncated");
+}
+
+template<typename T>
+void checkpoint_put(std::ostream& o, const T& value)
+{
+  static_assert(std::is_trivially_copyable_v<T>);
+  checkpoint_put_bytes(o, &value, sizeof(T));
+}
+
+template<typename T>
+void checkpoint_get(std::istream& i, T& value)
+{
+  static_assert(std::is_trivially_copyable_v<T>);
+  checkpoint_get_bytes(i, &value, sizeof(T));
+}
+
+// Reads a value that must match the current configuration
+template<typename T>
+void checkpoint_check(std::istream& i, const T& expected, const char* what)
+{
+  T value;
+  checkpoint_get(i, value);
+  if (value != expected)
+    throw std::runtime_error(std::string("checkpoint was saved with a different ") + what);
+}
+
+#endif
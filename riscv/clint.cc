@@ -3,6 +3,7 @@
 #include "devices.h"
 #include "processor.h"
 #include "simif.h"
+#include "checkpoint.h"
 #include "sim.h"
 #include "dts.h"
 
@@ -118,6 +119,31 @@ void clint_t::tick(reg_t rtc_ticks)
   }
 }
 
+void clint_t::save_state(std::ostream& o)
+{
+  checkpoint_put(o, mtime);
+  checkpoint_put(o, mtimecmp.size());
+  for (const auto& [hart_id, cmp] : mtimecmp) {
+    checkpoint_put(o, hart_id);
+    checkpoint_put(o, cmp);
+  }
+}
+
+void clint_t::restore_state(std::istream& i)
+{
+  checkpoint_get(i, mtime);
+  size_t n;
+  checkpoint_get(i, n);
+  mtimecmp.clear();
+  for (size_t k = 0; k < n; k++) {
+    size_t hart_id;
+    checkpoint_get(i, hart_id);
+    checkpoint_get(i, mtimecmp[hart_id]);
+  }
+  // Update the time CSRs and timer interrupts of the harts
+  tick(0);
+}
+
 clint_t* clint_parse_from_fdt(const void* fdt, const sim_t* sim, reg_t* base,
     const std::vector<std::string>& sargs UNUSED) {
   if (fdt_parse_clint(fdt, base, "riscv,clint0") == 0 || fdt_parse_clint(fdt, base, "sifive,clint0") == 0)
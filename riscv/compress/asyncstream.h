@@ -0,0 +1,333 @@
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include <lzma.h>
+#include <zstd.h>
+
+// Asynchronous compression for trace streams.
+//
+// An AsyncOStreamBuf collects its output in large fixed-size chunks. Full
+// chunks are handed off through a lock-free queue to the threads of an
+// AsyncCompressorPool, which compress each chunk as an independent xz stream
+// or zstd frame (both formats allow concatenation, so LzmaIStream and
+// ZstdIStream read the result as a single stream). Compressed chunks are
+// written to the sink in order by whichever compressor thread completes the
+// oldest pending chunk. Each stream owns a bounded number of chunks, so a
+// producer that runs ahead of the compressors blocks until a chunk is free.
+
+// Bounded multi-producer multi-consumer queue (Dmitry Vyukov's algorithm).
+template <typename T>
+class MpmcQueue {
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+  std::unique_ptr<Cell[]> cells;
+  const size_t mask;
+  alignas(64) std::atomic<size_t> enqueue_pos{0};
+  alignas(64) std::atomic<size_t> dequeue_pos{0};
+
+public:
+  MpmcQueue(size_t capacity) : cells(new Cell[capacity]), mask(capacity - 1) {
+    assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+    for (size_t i = 0; i < capacity; i++)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  bool push(const T& data) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = cells[pos & mask];
+      size_t seq = cell.sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+      if (diff == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.data = data;
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool pop(T& data) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = cells[pos & mask];
+      size_t seq = cell.sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          data = cell.data;
+          cell.sequence.store(pos + mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // empty
+      } else {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+};
+
+class AsyncOStreamBuf;
+
+class AsyncCompressorPool {
+private:
+  struct Job {
+    AsyncOStreamBuf *stream;
+    size_t chunk;
+  };
+  MpmcQueue<Job> queue;
+  std::counting_semaphore<> pending{0};
+  std::vector<std::thread> threads;
+  std::atomic<bool> stopping{false};
+
+  void worker();
+
+public:
+  AsyncCompressorPool(unsigned num_threads, size_t queue_capacity = 4096) : queue(queue_capacity) {
+    assert(num_threads > 0);
+    for (unsigned i = 0; i < num_threads; i++)
+      threads.emplace_back(&AsyncCompressorPool::worker, this);
+  }
+
+  ~AsyncCompressorPool() {
+    stopping.store(true, std::memory_order_release);
+    pending.release(threads.size());
+    for (auto& t : threads)
+      t.join();
+  }
+
+  void submit(AsyncOStreamBuf *stream, size_t chunk) {
+    while (!queue.push({stream, chunk}))
+      std::this_thread::yield();
+    pending.release();
+  }
+};
+
+class AsyncOStreamBuf : public std::streambuf {
+public:
+  enum class Method { NONE, LZMA, ZSTD };
+
+private:
+  enum State { FREE, QUEUED, DONE };
+  struct Chunk {
+    std::vector<char> in;
+    size_t in_size = 0;
+    std::vector<char> out;
+    size_t out_size = 0;
+    bool frame_start = false; // the chunk starts a frame registered with start_frame()
+    std::atomic<State> state{FREE};
+  };
+
+  AsyncCompressorPool &pool;
+  std::ostream &sink;
+  const Method method;
+  const int preset;
+  std::unique_ptr<Chunk[]> chunks;
+  const size_t num_chunks;
+  size_t next_fill = 0;  // chunk being filled by the producer
+  std::atomic<size_t> next_write{0}; // oldest chunk not yet written, only advanced under write_lock
+  std::counting_semaphore<> free_chunks;
+  std::mutex write_lock;
+  std::vector<uint64_t> frame_start_offsets; // written under write_lock
+  bool closed = false;
+
+  void start_chunk() {
+    free_chunks.acquire(); // back-pressure: wait until the compressors catch up
+    Chunk &c = chunks[next_fill];
+    assert(c.state.load(std::memory_order_acquire) == FREE);
+    setp(c.in.data(), c.in.data() + c.in.size());
+  }
+
+  void submit_chunk(bool start_next = true) {
+    Chunk &c = chunks[next_fill];
+    c.in_size = pptr() - pbase();
+    if (c.in_size == 0) {
+      if (!start_next) {
+        free_chunks.release(); // give back the chunk we were filling
+        setp(nullptr, nullptr);
+      }
+      return;
+    }
+    c.state.store(QUEUED, std::memory_order_release);
+    pool.submit(this, next_fill);
+    next_fill = (next_fill + 1) % num_chunks;
+    if (start_next)
+      start_chunk();
+    else
+      setp(nullptr, nullptr);
+  }
+
+  void wait_all_written() {
+    for (size_t i = 0; i < num_chunks; i++)
+      free_chunks.acquire();
+    free_chunks.release(num_chunks);
+  }
+
+protected:
+  int overflow(int c = EOF) override {
+    submit_chunk();
+    if (c != EOF) {
+      *pptr() = c;
+      pbump(1);
+    }
+    return 0;
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    std::streamsize done = 0;
+    while (done < n) {
+      if (pptr() == epptr())
+        submit_chunk();
+      std::streamsize k = std::min<std::streamsize>(n - done, epptr() - pptr());
+      memcpy(pptr(), s + done, k);
+      pbump(k);
+      done += k;
+    }
+    return n;
+  }
+
+  // Flushing does not cut the current chunk short: every chunk is compressed
+  // independently, so small chunks would ruin the compression ratio. Buffered
+  // data is written when the chunk is full or the stream is closed.
+  int sync() override {
+    return 0;
+  }
+
+public:
+  AsyncOStreamBuf(AsyncCompressorPool &pool, std::ostream &os, Method method, int preset,
+                  size_t chunk_size = 2 << 20, size_t num_chunks = 4)
+    : pool(pool), sink(os), method(method), preset(preset),
+      chunks(new Chunk[num_chunks]), num_chunks(num_chunks), free_chunks(num_chunks) {
+    for (size_t i = 0; i < num_chunks; i++)
+      chunks[i].in.resize(chunk_size);
+    start_chunk();
+  }
+
+  // Compresses one chunk, called from a pool thread.
+  void compress(size_t i) {
+    Chunk &c = chunks[i];
+    if (method == Method::LZMA) {
+      c.out.resize(lzma_stream_buffer_bound(c.in_size));
+      c.out_size = 0;
+      lzma_ret ret = lzma_easy_buffer_encode(preset, LZMA_CHECK_CRC64, nullptr,
+                                             (const uint8_t *) c.in.data(), c.in_size,
+                                             (uint8_t *) c.out.data(), &c.out_size, c.out.size());
+      assert(ret == LZMA_OK);
+    } else if (method == Method::ZSTD) {
+      thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx *)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+      ZSTD_CCtx_reset(cctx.get(), ZSTD_reset_session_and_parameters);
+      ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, preset);
+      ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_checksumFlag, 1);
+      c.out.resize(ZSTD_compressBound(c.in_size));
+      c.out_size = ZSTD_compress2(cctx.get(), c.out.data(), c.out.size(), c.in.data(), c.in_size);
+      assert(!ZSTD_isError(c.out_size));
+    } else {
+      c.out.swap(c.in);
+      c.out_size = c.in_size;
+      c.in.resize(c.out.size());
+    }
+    c.state.store(DONE, std::memory_order_release);
+  }
+
+  // Writes all consecutive compressed chunks, called from a pool thread.
+  void drain() {
+    for (;;) {
+      if (!write_lock.try_lock())
+        return; // the thread holding the lock will check our chunk after releasing it
+      size_t i = next_write.load(std::memory_order_relaxed);
+      while (chunks[i].state.load(std::memory_order_acquire) == DONE) {
+        Chunk &c = chunks[i];
+        if (c.frame_start) {
+          frame_start_offsets.push_back(sink.tellp());
+          c.frame_start = false;
+        }
+        sink.write(c.out.data(), c.out_size);
+        c.state.store(FREE, std::memory_order_release);
+        i = (i + 1) % num_chunks;
+        next_write.store(i, std::memory_order_relaxed);
+        free_chunks.release();
+      }
+      write_lock.unlock();
+      if (chunks[next_write.load(std::memory_order_relaxed)].state.load(std::memory_order_acquire) != DONE)
+        return;
+    }
+  }
+
+  // Chunks are compressed independently, so starting a frame only needs to
+  // cut the current chunk. Its offset is known once it has been written, see
+  // frame_offsets().
+  void start_frame() {
+    if (pptr() != pbase())
+      submit_chunk();
+    chunks[next_fill].frame_start = true;
+  }
+
+  // Offsets of the frames registered with start_frame(), in order. Only
+  // complete after close().
+  const std::vector<uint64_t>& frame_offsets() const {
+    return frame_start_offsets;
+  }
+
+  int close() {
+    if (closed)
+      return 0;
+    closed = true;
+    submit_chunk(false);
+    wait_all_written();
+    sink.flush();
+    return 0;
+  }
+
+  ~AsyncOStreamBuf() {
+    close();
+  }
+};
+
+inline void AsyncCompressorPool::worker() {
+  for (;;) {
+    pending.acquire();
+    Job job;
+    while (!queue.pop(job)) {
+      // Either we are being stopped or another producer has claimed an
+      // earlier slot of the queue but not yet published it.
+      if (stopping.load(std::memory_order_acquire))
+        return;
+      std::this_thread::yield();
+    }
+    job.stream->compress(job.chunk);
+    job.stream->drain();
+  }
+}
+
+class AsyncOStream : public std::ostream {
+private:
+  std::ofstream underlying_ofstream;
+  AsyncOStreamBuf buf;
+public:
+  AsyncOStream(AsyncCompressorPool &pool, const std::string &filename, AsyncOStreamBuf::Method method, int preset)
+    : std::ostream(&buf), buf(pool, underlying_ofstream, method, preset) {
+    underlying_ofstream.open(filename, std::ios::out | std::ios::binary);
+  }
+  int close() { return buf.close(); }
+  void start_frame() { buf.start_frame(); }
+  const std::vector<uint64_t>& frame_offsets() const { return buf.frame_offsets(); }
+};
@@ -9,6 +9,7 @@ private:
   lzma_stream strm = LZMA_STREAM_INIT;
   char outbuf[16 * 1024];
   std::ostream &sink;
+  const int preset;
   
 protected:
   int overflow(int c = EOF) override {
@@ -56,7 +57,7 @@ protected:
   }
 
 public:
-  LzmaOStreamBuf(std::ostream &os, int preset = 6) : sink(os) {
+  LzmaOStreamBuf(std::ostream &os, int preset = 6) : sink(os), preset(preset) {
     auto ret = lzma_easy_encoder(&strm, preset, LZMA_CHECK_CRC64);
     assert(ret == LZMA_OK);
   }
@@ -65,6 +66,15 @@ public:
     return sync_internal(true);
   }
 
+  // Ends the current xz stream and starts a new one, so that the following
+  // output can be decompressed on its own. Returns the offset of the new stream.
+  uint64_t start_frame() {
+    close();
+    auto ret = lzma_easy_encoder(&strm, preset, LZMA_CHECK_CRC64);
+    assert(ret == LZMA_OK);
+    return sink.tellp();
+  }
+
   ~LzmaOStreamBuf() {
     close();
     lzma_end(&strm);
@@ -81,6 +91,7 @@ public:
     underlying_ofstream.open(filename);
   }
   int close() { return buf.close(); }
+  uint64_t start_frame() { return buf.start_frame(); }
 };
 
 
@@ -3,6 +3,7 @@
 #include <streambuf>
 #include <vector>
 #include <cassert>
+#include <cstdint>
 #include <zstd.h>
 
 class ZstdOStreamBuf : public std::streambuf {
@@ -65,6 +66,13 @@ public:
   int close() {
     return sync_internal(true);
   }
+
+  // Ends the current zstd frame; the next write starts a new one that can be
+  // decompressed on its own. Returns the offset of the new frame.
+  uint64_t start_frame() {
+    close();
+    return sink.tellp();
+  }
   
   ~ZstdOStreamBuf() {
     close();
@@ -82,6 +90,7 @@ public:
     underlying_ofstream.open(filename);
   }
   int close() { return buf.close(); }
+  uint64_t start_frame() { return buf.start_frame(); }
 };
 
 class ZstdIStreamBuf : public std::streambuf {
@@ -63,7 +63,7 @@ void csr_t::log_write() const noexcept {
 }
 
 void csr_t::log_special_write(const reg_t UNUSED address, const reg_t UNUSED val) const noexcept {
-  if (proc->get_log_commits_enabled() || proc->get_log_g4trace_enabled())
+  if (proc->get_log_accesses_enabled())
     proc->get_state()->log_reg_write[((address) << 4) | 4] = {val, 0};
 }
 
@@ -461,12 +461,11 @@ reg_t base_status_csr_t::adjust_sd(const reg_t val) const noexcept {
   return val & ~sd_bit;
 }
 
-void base_status_csr_t::maybe_flush_tlb(const reg_t newval) noexcept {
-  if ((newval ^ read()) &
+bool base_status_csr_t::changes_translation(const reg_t newval) const noexcept {
+  return (newval ^ read()) &
       (MSTATUS_MPP | MSTATUS_MPRV
        | (has_page ? (MSTATUS_MXR | MSTATUS_SUM) : 0)
-      ))
-    proc->get_mmu()->flush_tlb();
+      );
 }
 
 namespace {
@@ -492,8 +491,10 @@ bool vsstatus_csr_t::unlogged_write(const reg_t val) noexcept {
 
   newval = (newval & SSTATUS_SDT) ? (newval & ~SSTATUS_SIE) : newval;
 
-  if (state->v) maybe_flush_tlb(newval);
+  const bool switch_tlb = state->v && changes_translation(newval);
   this->val = adjust_sd(newval);
+  if (switch_tlb)
+    proc->get_mmu()->switch_tlb_context();
   return true;
 }
 
@@ -558,8 +559,10 @@ bool mstatus_csr_t::unlogged_write(const reg_t val) noexcept {
   reg_t new_mstatus = (read() & ~mask) | (adjusted_val & mask);
   new_mstatus = (new_mstatus & MSTATUS_MDT) ? (new_mstatus & ~MSTATUS_MIE) : new_mstatus;
   new_mstatus = (new_mstatus & MSTATUS_SDT) ? (new_mstatus & ~MSTATUS_SIE) : new_mstatus;
-  maybe_flush_tlb(new_mstatus);
+  const bool switch_tlb = changes_translation(new_mstatus);
   this->val = adjust_sd(new_mstatus);
+  if (switch_tlb)
+    proc->get_mmu()->switch_tlb_context();
   return true;
 }
 
@@ -592,7 +595,12 @@ bool mnstatus_csr_t::unlogged_write(const reg_t val) noexcept {
   const reg_t adjusted_val = set_field(val, MNSTATUS_MNPP, requested_mnpp);
   const reg_t new_mnstatus = (read() & ~mask) | (adjusted_val & mask);
 
-  return basic_csr_t::unlogged_write(new_mnstatus);
+  // Setting NMIE can put MPRV into effect
+  const bool switch_tlb = (new_mnstatus ^ read()) & MNSTATUS_NMIE;
+  basic_csr_t::unlogged_write(new_mnstatus);
+  if (switch_tlb)
+    proc->get_mmu()->switch_tlb_context();
+  return true;
 }
 
 // implement class rv32_low_csr_t
@@ -749,6 +757,9 @@ bool misa_csr_t::unlogged_write(const reg_t val) noexcept {
     }
   }
 
+  // --jit translations evaluate the extension checks at translation time
+  proc->get_mmu()->flush_blocks();
+
   return basic_csr_t::unlogged_write(new_misa);
 }
 
@@ -768,10 +779,15 @@ reg_t mip_or_mie_csr_t::read() const noexcept {
 }
 
 void mip_or_mie_csr_t::write_with_mask(const reg_t mask, const reg_t val) noexcept {
-  this->val = (this->val & ~mask) | (val & mask);
+  update(mask, val);
   log_write();
 }
 
+void mip_or_mie_csr_t::update(const reg_t mask, const reg_t val) noexcept {
+  reg_t old = this->val.load(std::memory_order_relaxed);
+  while (!this->val.compare_exchange_weak(old, (old & ~mask) | (val & mask))) {}
+}
+
 bool mip_or_mie_csr_t::unlogged_write(const reg_t val) noexcept {
   write_with_mask(write_mask(), val);
   return false; // avoid double logging: already logged by write_with_mask()
@@ -786,7 +802,7 @@ reg_t mip_csr_t::read() const noexcept {
 }
 
 void mip_csr_t::backdoor_write_with_mask(const reg_t mask, const reg_t val) noexcept {
-  this->val = (this->val & ~mask) | (val & mask);
+  update(mask, val);
 }
 
 reg_t mip_csr_t::write_mask() const noexcept {
@@ -981,10 +997,14 @@ bool envcfg_csr_t::unlogged_write(const reg_t val) noexcept {
   const reg_t pmm = get_field(adjusted_val, MENVCFG_PMM);
   adjusted_val = set_field(adjusted_val, MENVCFG_PMM, pmm != pmm_reserved ? pmm : 0);
 
-  if (get_field(adjusted_val, MENVCFG_PMM) != get_field(read(), MENVCFG_PMM))
+  // PBMTE, ADUE and SSE change which PTEs are valid, and TLB entries are
+  // kept across context switches
+  const reg_t translation_bits = MENVCFG_PMM | MENVCFG_PBMTE | MENVCFG_ADUE | MENVCFG_SSE;
+  const reg_t old_val = read();
+  masked_csr_t::unlogged_write(adjusted_val);
+  if ((read() ^ old_val) & translation_bits)
     proc->get_mmu()->flush_tlb();
-
-  return masked_csr_t::unlogged_write(adjusted_val);
+  return true;
 }
 
 // implement class henvcfg_csr_t
@@ -1000,9 +1020,11 @@ base_atp_csr_t::base_atp_csr_t(processor_t* const proc, const reg_t addr):
 
 bool base_atp_csr_t::unlogged_write(const reg_t val) noexcept {
   const reg_t newval = proc->supports_impl(IMPL_MMU) ? compute_new_satp(val) : 0;
-  if (newval != read())
-    proc->get_mmu()->flush_tlb();
-  return basic_csr_t::unlogged_write(newval);
+  const bool switch_tlb = newval != read();
+  basic_csr_t::unlogged_write(newval);
+  if (switch_tlb)
+    proc->get_mmu()->switch_tlb_context();
+  return true;
 }
 
 bool base_atp_csr_t::satp_valid(reg_t val) const noexcept {
@@ -1244,8 +1266,6 @@ void hgatp_csr_t::verify_permissions(insn_t insn, bool write) const {
 }
 
 bool hgatp_csr_t::unlogged_write(const reg_t val) noexcept {
-  proc->get_mmu()->flush_tlb();
-
   reg_t mask;
   if (proc->get_const_xlen() == 32) {
     mask = HGATP32_PPN |
@@ -1262,7 +1282,9 @@ bool hgatp_csr_t::unlogged_write(const reg_t val) noexcept {
       mask |= HGATP64_MODE;
   }
   mask &= ~(reg_t)3;
-  return basic_csr_t::unlogged_write((read() & ~mask) | (val & mask));
+  basic_csr_t::unlogged_write((read() & ~mask) | (val & mask));
+  proc->get_mmu()->switch_tlb_context();
+  return true;
 }
 
 tselect_csr_t::tselect_csr_t(processor_t* const proc, const reg_t addr):
@@ -8,6 +8,8 @@
 #include "decode.h"
 // For std::unordered_map
 #include <unordered_map>
+// For std::atomic
+#include <atomic>
 // For std::shared_ptr
 #include <memory>
 // For std::optional
@@ -224,7 +226,8 @@ class base_status_csr_t: public csr_t {
 
  protected:
   reg_t adjust_sd(const reg_t val) const noexcept;
-  void maybe_flush_tlb(const reg_t newval) noexcept;
+  // Whether writing newval changes how addresses are translated
+  bool changes_translation(const reg_t newval) const noexcept;
   const bool has_page;
   const reg_t sstatus_write_mask;
   const reg_t sstatus_read_mask;
@@ -360,7 +363,9 @@ class mip_or_mie_csr_t: public csr_t {
 
  protected:
   virtual bool unlogged_write(const reg_t val) noexcept override final;
-  reg_t val;
+  void update(const reg_t mask, const reg_t val) noexcept;
+  // Atomic because devices (clint, plic) write mip from other harts' threads
+  std::atomic<reg_t> val;
  private:
   virtual reg_t write_mask() const noexcept = 0;
 };
@@ -15,6 +15,13 @@
 #define STATE (*p->get_state())
 #define FLEN (p->get_flen())
 #define CHECK_REG(reg) ((void) 0)
+
+/* DECODE_MACRO_USAGE_LOGGED selects what is recorded in log_reg_read/write:
+ * 0 : nothing (fast variants)
+ * 1 : register ids and values, for the commit log (logged variants)
+ * 2 : register ids only, except for the values of the integer registers read,
+ *     which the g4trace decoders use to compute jump targets (g4trace variants)
+ */
 #define READ_REG(reg) ({\
     CHECK_REG(reg); \
     reg_t rdata = STATE.XPR[reg];                   \
@@ -24,8 +31,10 @@
   })
 #define READ_FREG(reg) ({            \
     freg_t rdata = STATE.FPR[reg]; \
-    if (DECODE_MACRO_USAGE_LOGGED)                      \
+    if (DECODE_MACRO_USAGE_LOGGED == 1)                 \
       STATE.log_reg_read[(reg) << 4 | 1] = rdata ;     \
+    else if (DECODE_MACRO_USAGE_LOGGED == 2)            \
+      STATE.log_reg_read.insert_id((reg) << 4 | 1);    \
     rdata ;                        \
   })
       
@@ -46,12 +55,14 @@
 #define WRITE_REG(reg, value) ({ \
     CHECK_REG(reg); \
     reg_t wdata = (value); /* value may have side effects */ \
-    if (DECODE_MACRO_USAGE_LOGGED) STATE.log_reg_write[(reg) << 4] = {wdata, 0}; \
+    if (DECODE_MACRO_USAGE_LOGGED == 1) STATE.log_reg_write[(reg) << 4] = {wdata, 0}; \
+    else if (DECODE_MACRO_USAGE_LOGGED == 2) STATE.log_reg_write.insert_id((reg) << 4); \
     STATE.XPR.write(reg, wdata); \
   })
 #define WRITE_FREG(reg, value) ({ \
     freg_t wdata = freg(value); /* value may have side effects */ \
-    if (DECODE_MACRO_USAGE_LOGGED) STATE.log_reg_write[((reg) << 4) | 1] = wdata; \
+    if (DECODE_MACRO_USAGE_LOGGED == 1) STATE.log_reg_write[((reg) << 4) | 1] = wdata; \
+    else if (DECODE_MACRO_USAGE_LOGGED == 2) STATE.log_reg_write.insert_id(((reg) << 4) | 1); \
     DO_WRITE_FREG(reg, wdata); \
   })
 #define WRITE_VSTATUS STATE.log_reg_write[3] = {0, 0};
@@ -265,6 +276,8 @@ class wait_for_interrupt_t {};
 /* Sentinel PC values to serialize simulator pipeline */
 #define PC_SERIALIZE_BEFORE 3
 #define PC_SERIALIZE_AFTER 5
+#define PC_SWITCH_TO_LOGGED 7
+#define PC_STOP_AT_START_TRACING 9
 #define invalid_pc(pc) ((pc) & 1)
 
 /* Convenience wrappers to simplify softfloat code sequences */
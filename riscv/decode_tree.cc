@@ -0,0 +1,75 @@
+// See LICENSE for license details.
+
+#include "decode_tree.h"
+#include "arith.h"
+#include <algorithm>
+
+// Leaves are scanned linearly, which beats testing more bits for this many
+static const size_t MAX_LEAF_PATTERNS = 4;
+
+void insn_decode_tree_t::build(const std::vector<pattern_t>& patterns)
+{
+  this->patterns = patterns;
+  nodes.clear();
+  leaves.clear();
+
+  std::vector<uint32_t> all(patterns.size());
+  for (uint32_t i = 0; i < all.size(); i++)
+    all[i] = i;
+  build_node(all);
+}
+
+uint32_t insn_decode_tree_t::build_node(const std::vector<uint32_t>& candidates)
+{
+  uint32_t n = nodes.size();
+  nodes.push_back({-1, {0, 0}, 0, 0});
+
+  // Split on the bit that leaves the fewest candidates on the larger side
+  int best_bit = -1;
+  size_t best_max = candidates.size(), best_sum = 0;
+  if (candidates.size() > MAX_LEAF_PATTERNS) {
+    // Patterns that ignore a bit go down both sides
+    const int nbits = 8 * sizeof(insn_bits_t);
+    size_t care[nbits] = {}, ones[nbits] = {};
+    for (uint32_t idx : candidates) {
+      const pattern_t& p = patterns[idx];
+      for (insn_bits_t m = p.mask; m; m &= m - 1) {
+        int bit = ctz(m);
+        care[bit]++;
+        ones[bit] += (p.match >> bit) & 1;
+      }
+    }
+
+    for (int bit = 0; bit < nbits; bit++) {
+      size_t n0 = candidates.size() - ones[bit];
+      size_t n1 = candidates.size() - care[bit] + ones[bit];
+      size_t max = std::max(n0, n1), sum = n0 + n1;
+      if (max < best_max || (max == best_max && best_bit >= 0 && sum < best_sum)) {
+        best_bit = bit;
+        best_max = max;
+        best_sum = sum;
+      }
+    }
+  }
+
+  if (best_bit < 0) {
+    nodes[n].first = leaves.size();
+    nodes[n].count = candidates.size();
+    leaves.insert(leaves.end(), candidates.begin(), candidates.end());
+    return n;
+  }
+
+  // Candidates keep their relative order on both sides
+  for (unsigned value = 0; value < 2; value++) {
+    std::vector<uint32_t> side;
+    for (uint32_t idx : candidates) {
+      const pattern_t& p = patterns[idx];
+      if (!((p.mask >> best_bit) & 1) || ((p.match >> best_bit) & 1) == value)
+        side.push_back(idx);
+    }
+    uint32_t child = build_node(side);
+    nodes[n].next[value] = child;
+  }
+  nodes[n].bit = best_bit;
+  return n;
+}
@@ -0,0 +1,54 @@
+// See LICENSE for license details.
+#ifndef _RISCV_DECODE_TREE_H
+#define _RISCV_DECODE_TREE_H
+
+#include "decode.h"
+#include <cstdint>
+#include <vector>
+
+// Finds the first of a list of mask/match patterns that an instruction
+// matches, as processor_t::decode_insn does on opcode_cache misses. Each
+// inner node tests one instruction bit; patterns that do not care about the
+// bit go down both sides. Leaves hold the few patterns left, in list order,
+// so overlapping patterns still resolve to the earliest one.
+class insn_decode_tree_t
+{
+public:
+  struct pattern_t {
+    insn_bits_t mask;
+    insn_bits_t match;
+  };
+
+  // patterns are given in priority order
+  void build(const std::vector<pattern_t>& patterns);
+
+  // Index of the first matching pattern, or the number of patterns if none
+  size_t lookup(insn_bits_t bits) const
+  {
+    uint32_t n = 0;
+    while (nodes[n].bit >= 0)
+      n = nodes[n].next[(bits >> nodes[n].bit) & 1];
+
+    for (uint32_t i = nodes[n].first; i < nodes[n].first + nodes[n].count; i++) {
+      uint32_t idx = leaves[i];
+      if ((bits & patterns[idx].mask) == patterns[idx].match)
+        return idx;
+    }
+    return patterns.size();
+  }
+
+private:
+  struct node_t {
+    int bit; // -1 for leaves
+    uint32_t next[2];
+    uint32_t first, count; // range of leaves
+  };
+
+  uint32_t build_node(const std::vector<uint32_t>& candidates);
+
+  std::vector<pattern_t> patterns;
+  std::vector<node_t> nodes;
+  std::vector<uint32_t> leaves;
+};
+
+#endif
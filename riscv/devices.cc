@@ -1,5 +1,6 @@
 #include "devices.h"
 #include "mmu.h"
+#include "checkpoint.h"
 #include <stdexcept>
 
 mmio_device_map_t& mmio_device_map()
@@ -132,6 +133,7 @@ bool mem_t::load_store(reg_t addr, size_t len, uint8_t* bytes, bool store)
 
 char* mem_t::contents(reg_t addr) {
   reg_t ppn = addr >> PGSHIFT, pgoff = addr % PGSIZE;
+  std::lock_guard<std::mutex> guard(sparse_memory_map_lock);
   auto search = sparse_memory_map.find(ppn);
   if (search == sparse_memory_map.end()) {
     auto res = (char*)calloc(PGSIZE, 1);
@@ -156,6 +158,26 @@ void mem_t::dump(std::ostream& o) {
   }
 }
 
+void mem_t::save_state(std::ostream& o) {
+  checkpoint_put(o, sz);
+  checkpoint_put(o, sparse_memory_map.size());
+  for (const auto& [ppn, page] : sparse_memory_map) {
+    checkpoint_put(o, ppn);
+    checkpoint_put_bytes(o, page, PGSIZE);
+  }
+}
+
+void mem_t::restore_state(std::istream& i) {
+  checkpoint_check(i, sz, "memory size");
+  size_t pages;
+  checkpoint_get(i, pages);
+  for (size_t n = 0; n < pages; n++) {
+    reg_t ppn;
+    checkpoint_get(i, ppn);
+    checkpoint_get_bytes(i, contents(ppn << PGSHIFT), PGSIZE);
+  }
+}
+
 external_sim_device_t::external_sim_device_t(void* sim) 
   : external_simulator(sim) {}
 
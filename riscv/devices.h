@@ -6,6 +6,7 @@
 #include "abstract_interrupt_controller.h"
 #include "platform.h"
 #include <map>
+#include <mutex>
 #include <queue>
 #include <vector>
 #include <utility>
@@ -63,11 +64,14 @@ class mem_t : public abstract_mem_t {
   char* contents(reg_t addr) override;
   reg_t size() override { return sz; }
   void dump(std::ostream& o) override;
+  void save_state(std::ostream& o) override;
+  void restore_state(std::istream& i) override;
 
  private:
   bool load_store(reg_t addr, size_t len, uint8_t* bytes, bool store);
 
   std::map<reg_t, char*> sparse_memory_map;
+  std::mutex sparse_memory_map_lock; // pages are allocated by harts on several threads
   reg_t sz;
 };
 
@@ -97,6 +101,8 @@ class clint_t : public abstract_device_t {
   bool store(reg_t addr, size_t len, const uint8_t* bytes) override;
   reg_t size() override { return CLINT_SIZE; }
   void tick(reg_t rtc_ticks) override;
+  void save_state(std::ostream& o) override;
+  void restore_state(std::istream& i) override;
   uint64_t get_mtimecmp(reg_t hartid) { return mtimecmp[hartid]; }
   uint64_t get_mtime() { return mtime; }
  private:
@@ -135,6 +141,8 @@ class plic_t : public abstract_device_t, public abstract_interrupt_controller_t
   bool load(reg_t addr, size_t len, uint8_t* bytes) override;
   bool store(reg_t addr, size_t len, const uint8_t* bytes) override;
   void set_interrupt_level(uint32_t id, int lvl) override;
+  void save_state(std::ostream& o) override;
+  void restore_state(std::istream& i) override;
   reg_t size() override { return PLIC_SIZE; }
  private:
   std::vector<plic_context_t> contexts;
@@ -166,6 +174,8 @@ class ns16550_t : public abstract_device_t {
   bool load(reg_t addr, size_t len, uint8_t* bytes) override;
   bool store(reg_t addr, size_t len, const uint8_t* bytes) override;
   void tick(reg_t rtc_ticks) override;
+  void save_state(std::ostream& o) override;
+  void restore_state(std::istream& i) override;
   reg_t size() override { return NS16550_SIZE; }
  private:
   abstract_interrupt_controller_t *intctrl;
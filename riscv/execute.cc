@@ -178,6 +178,8 @@ static inline reg_t execute_insn_logged(processor_t* p, reg_t pc, insn_fetch_t f
   reg_t npc;
 
   if (fetch.insn.bits() == 0x40205013 /* srai zero, zero, 2 */) {
+    if (p->get_stop_at_start_tracing())
+      return PC_STOP_AT_START_TRACING;
     // Start tracing
     p->set_log_active(true);
   } else if (fetch.insn.bits() == 0x40005013 /* srai zero, zero, 0 */) {
@@ -226,7 +228,7 @@ static inline reg_t execute_insn_logged(processor_t* p, reg_t pc, insn_fetch_t f
   p->update_histogram(pc);
 
   if (fetch.insn.bits() == 0x40105013 /* srai zero, zero, 1 */
-      || p->get_state()->g4trace.instructions_traced >= p->get_log_g4trace_max_instructions()) {
+      || (p->get_log_g4trace_enabled() && p->get_state()->g4trace.instructions_traced >= p->get_log_g4trace_max_instructions())) {
     // End ROI
     p->set_log_active(false);
   }
@@ -236,8 +238,11 @@ static inline reg_t execute_insn_logged(processor_t* p, reg_t pc, insn_fetch_t f
 
 bool processor_t::slow_path()
 {
+  // Outside ROIs, g4trace harts stay on the fast path until they reach a ROI
+  // start hint (see g4trace_roi_start_hint).
   return debug || state.single_step != state.STEP_NONE || state.debug_mode ||
-         log_commits_enabled || get_log_g4trace_enabled() || histogram_enabled || in_wfi || check_triggers_icount;
+         log_commits_enabled || (get_log_g4trace_enabled() && log_active) ||
+         histogram_enabled || in_wfi || check_triggers_icount;
 }
 
 // fetch/decode/execute loop
@@ -266,6 +271,8 @@ void processor_t::step(size_t n)
         switch (pc) { \
           case PC_SERIALIZE_BEFORE: state.serialized = true; break; \
           case PC_SERIALIZE_AFTER: ++instret; break; \
+          case PC_SWITCH_TO_LOGGED: break; \
+          case PC_STOP_AT_START_TRACING: stopped_at_start_tracing = true; n = instret; break; \
           default: abort(); \
         } \
         pc = state.pc; \
@@ -334,16 +341,32 @@ void processor_t::step(size_t n)
       else while (instret < n)
       {
         // Main simulation loop, fast path.
-        for (auto ic_entry = _mmu->access_icache(pc); ; ) {
-          auto fetch = ic_entry->data;
-          pc = execute_insn_fast(this, pc, fetch);
-          ic_entry = ic_entry->next;
-          if (unlikely(ic_entry->tag != pc))
-            break;
-          if (unlikely(instret + 1 == n))
-            break;
-          instret++;
-          state.pc = pc;
+        auto block = _mmu->access_block(pc);
+        if (likely(block && n - instret > block->ninsns)) {
+          // Leave the block at its end or when an instruction does not
+          // fall through (taken branch, jump, serialization)
+          for (auto e = block->insns, end = e + block->size; ; ) {
+            pc = e->func(this, e->insn, pc);
+            if (unlikely(pc != e->npc))
+              break;
+            instret += e->fused;
+            if (++e == end)
+              break;
+            instret++;
+            state.pc = pc;
+          }
+        } else {
+          for (auto ic_entry = _mmu->access_icache(pc); ; ) {
+            auto fetch = ic_entry->data;
+            pc = execute_insn_fast(this, pc, fetch);
+            ic_entry = ic_entry->next;
+            if (unlikely(ic_entry->tag != pc))
+              break;
+            if (unlikely(instret + 1 == n))
+              break;
+            instret++;
+            state.pc = pc;
+          }
         }
 
         advance_pc();
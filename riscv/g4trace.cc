@@ -3,8 +3,15 @@
 #include "disasm.h"
 #include "compress/lzmastream.h"
 #include "compress/zstdstream.h"
+#include "compress/asyncstream.h"
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <iomanip>
+#include <semaphore>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 
 using namespace std;
 
@@ -31,6 +38,12 @@ static G4TraceRegId g4trace_regid_from_commit_log_reg_id(reg_t commit_log_reg_id
       assert(false);
   }
 }
+// inverse of g4trace_regid_from_commit_log_reg_id for x, f and v registers
+static reg_t g4trace_commit_log_reg_id(G4TraceRegId id) {
+  assert(id.id >= 0 && id.id < 96);
+  return (reg_t(id.id % 32) << 4) | (id.id / 32);
+}
+
 static bool commit_log_reg_id_is_vstatus(reg_t commit_log_reg_id) {
   return (commit_log_reg_id & 0xf) == 3;
 }
@@ -38,11 +51,6 @@ static bool commit_log_reg_id_is_csr(reg_t commit_log_reg_id) {
   return (commit_log_reg_id & 0xf) == 4;
 }
 
-template <typename T, typename... Args>
-bool eq_any(const T& first, const Args&... rest) {
-  return ((first == rest) || ...);
-}
-
 static reg_t commit_log_read_value_xpr(processor_t *p, reg_t reg_id) {
   auto i = p->get_state()->log_reg_read.find(reg_id << 4);
   assert(i != p->get_state()->log_reg_read.end());
@@ -70,314 +78,280 @@ static G4VectorMemAccessType g4trace_decode_mem_access_type(insn_t insn) {
   }
 }
 
-static G4TraceDecoder g4trace_get_decoder_internal(const string& instr_name) { // g4trace_get_decoder does some (optional) logging before this.
-#define DECODER_ARGS processor_t *p, reg_t pc, insn_t insn
-  if (instr_name == "srai") {
-    return [](DECODER_ARGS) { 
-      if (insn.bits() == 0x40205013 /* srai zero, zero, 2 */) {
-        return G4InstInfo { G4InstType::START_TRACING }; ;
-      } else if (insn.bits() == 0x40005013 /* srai zero, zero, 0 */) {
-        return G4InstInfo { G4InstType::CLEAR };   // ROI start
-        } else if (insn.bits() == 0x40105013 /* srai zero, zero, 1 */) {
-        return G4InstInfo { G4InstType::END_ROI };   // ROI end
-      } else {
-        return G4InstInfo { G4InstType::GENERIC }; 
-      }
-    };
-  } else if (eq_any(instr_name,
-                    "add", "addi", "addiw", "addw", "add_uw", "and", "andn", "andi", "auipc", "lui", "or", "ori", "sll", "slli",
-                    "slliw", "sllw", "slt", "slti", "sltiu", "sltu", "sra", "sraiw", "sraw", "srl",
-                    "srli", "srliw", "srlw", "sub", "subw", "xor", "xori",
-                    "c_add", "c_addi", "c_addi4spn", "c_addw", "c_and", "c_andi",
-                    "c_li", "c_lui", "c_mv", "c_or", "c_slli", "c_srai", "c_srli", "c_sub", "c_subw", "c_xor")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::GENERIC }; };
-  } else if (eq_any(instr_name, "beq", "bge", "bgeu", "blt", "bltu", "bne")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::B };
-      ret.target_address = pc + insn.sb_imm();
-      return ret;
-    };
-  } else if (eq_any(instr_name, "c_beqz", "c_bnez")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::B };
-      ret.target_address = pc + insn.rvc_b_imm();
-      return ret;
-    };
-  } else if (eq_any(instr_name, "c_j")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::J };
-      ret.target_address = pc + insn.rvc_j_imm();
-      return ret;
-    };
-  } else if (eq_any(instr_name, "c_jr")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret;
-      if ((insn.rvc_rs1() == 1 || insn.rvc_rs1() == 5) && insn.rvc_imm() == 0) {
-        ret.type = G4InstType::r;
-      } else {
-        ret.type = G4InstType::j;
-      }
-      ret.target_address = commit_log_read_value_xpr(p, insn.rvc_rs1()) & ~reg_t(1);
-      return ret;
-    };
-/* } else if (eq_any(instr_name, "c_jalr")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret;
-      ret.type = G4InstType::c; // (or r?)
-      ret.target_address = p->get_state()->XPR[insn.rvc_rs1()] & ~reg_t(1);
-      return ret;
-    };
-    */
-  } else if (eq_any(instr_name, "c_jal")) { // this is actually c.addiw (difference between RV32 an RV64 and spike weirdness)
-    return [](DECODER_ARGS) {
-      assert(insn.rvc_rd() != 0);
-      return G4InstInfo { G4InstType::GENERIC }; };
-  } else if (eq_any(instr_name, "jal")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret;
-      if (insn.rd() == 0) {
-        ret.type = G4InstType::J; // J pseudoinstruction
-      } else {
-        assert((insn.rd() == 1 || insn.rd() == 5) || "JAL with unexpected destination register. Probably should be treated as J.");
-        ret.type = G4InstType::C;
-      }
-      ret.target_address = pc + insn.uj_imm();
-      return ret;
-    };
-  } else if (eq_any(instr_name, "jalr")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret;
-      bool rdislink = insn.rd() == 1 || insn.rd() == 5;
-      bool rs1islink = insn.rs1() == 1 || insn.rs1() == 5;
-      if (!rdislink && rs1islink) {
-        ret.type = G4InstType::r; // ret
-      } else {
-        ret.type = G4InstType::c;
-      }
-      ret.target_address = (commit_log_read_value_xpr(p, insn.rs1()) + insn.i_imm()) & ~reg_t(1);
-      return ret;
-    };
-  } else if (eq_any(instr_name, "c_jalr")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret;
-      ret.type = G4InstType::c;
-      ret.target_address = commit_log_read_value_xpr(p, insn.rvc_rs1()) & ~reg_t(1);
-      return ret;
-    };
-  } else if (eq_any(instr_name,
-                    "lb", "lbu", "ld", "lh", "lhu", "lw", "lwu",
-                    "fld", "flw", "flq", "flw",
-                    "vle8_v", "vle16_v", "vle32_v", "vle64_v", "vle8ff_v", "vle16ff_v", "vle32ff_v", "vle64ff_v"
-                    "vluxei8_v", "vluxei16_v", "vluxei32_v", "vluxei64_v",
-                    "vlse8_v", "vlse16_v", "vlse32_v", "vlse64_v",
-                    "vlm_v",
-                    "vl1re16_v", "vl1re32_v", "vl1re64_v", "vl1re8_v", "vl2re16_v", "vl2re32_v", "vl2re64_v", "vl2re8_v", 
-                    "vl4re16_v", "vl4re32_v", "vl4re64_v", "vl4re8_v", "vl8re16_v", "vl8re32_v", "vl8re64_v", "vl8re8_v")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::L };
-      ret.memory_access_type = g4trace_decode_mem_access_type(insn);
-      return ret;
-    };
-  } else if (eq_any(instr_name,
-                    "c_fld", "c_ld", "c_lw", "c_lbu", "c_lb", "c_lhu", "c_lh", "c_fld", "c_ldsp", "c_lwsp", "c_fldsp")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::L };
-      ret.memory_access_type = G4VectorMemAccessType::SCALAR;
-      return ret;
-    };
-  } else if (eq_any(instr_name, "c_sd", "c_sw", "c_fsd")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::S };
-      auto first3bits = (insn.bits() & 0xe000) >> 13;
-      ret.S_base_reg = g4trace_regid_x(insn.rvc_rs1s());
-      ret.S_data_reg =
-        first3bits == 0x5 ? g4trace_regid_f(insn.rvc_rs2s()) // FSD
-        : first3bits == 0x6 ? g4trace_regid_x(insn.rvc_rs2s()) // SW
-        : first3bits == 0x7 ? g4trace_regid_x(insn.rvc_rs2s()) // SD
-        : g4trace_regid_invalid;
-      ret.memory_access_type = G4VectorMemAccessType::SCALAR;
-      return ret;
-    };
-  } else if (eq_any(instr_name, "c_sdsp", "c_swsp", "c_fsdsp")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::S };
-      auto first3bits = (insn.bits() & 0xe000) >> 13;
-      ret.S_base_reg = g4trace_regid_x(2); // sp, x2
-      ret.S_data_reg =
-        first3bits == 0x5 ? g4trace_regid_f(insn.rvc_rs2()) // s_fsdsp
-        : first3bits == 0x6 ? g4trace_regid_x(insn.rvc_rs2()) // c_swsp
-        : first3bits == 0x7 ? g4trace_regid_x(insn.rvc_rs2()) // c_sdsp
-        : g4trace_regid_invalid;
-      ret.memory_access_type = G4VectorMemAccessType::SCALAR;
-      return ret;
-    };
-  } else if (eq_any(instr_name,
-                    "sb", "sd", "sh", "sw",
-                    "vse8_v", "vse16_v", "vse32_v", "vse64_v",
-                    "vsuxei8_v", "vsuxei16_v", "vsuxei32_v", "vsuxei64_v",
-                    "vsm_v",
-                    "vs1r_v" /* TODO: , "vs2r_v","vs4r_v", "vs8r_v" */)) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::S };
-      ret.S_base_reg = g4trace_regid_x(insn.rs1());
-      ret.memory_access_type = g4trace_decode_mem_access_type(insn);
-      if (ret.memory_access_type == G4VectorMemAccessType::SCALAR) {
-        ret.S_data_reg = g4trace_regid_x(insn.rs2());
-      } else {
-        ret.S_data_reg = g4trace_regid_v(insn.rd());  // TODO: this is not correct for Vector Store Whole Register instructions that write more than one register (vs2r_v vs4r_v vs8r_v) and Vector Store Segment Instructions 
-      }
-      return ret;
-    };
-  } else if (eq_any(instr_name,
-                    "fsd", "fsh", "fsq", "fsw")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::S };
-      ret.S_base_reg = g4trace_regid_x(insn.rs1());
-      ret.memory_access_type = g4trace_decode_mem_access_type(insn);
-      if (ret.memory_access_type == G4VectorMemAccessType::SCALAR) {
-        ret.S_data_reg = g4trace_regid_f(insn.rs2());
-      } else {
-        ret.S_data_reg = g4trace_regid_v(insn.rd());  // Actually covered in the integer store case
-      }
-      return ret;
-    };
-  } else if (eq_any(instr_name, "lr_d", "lr_w")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::LR };
-      ret.memory_access_type = G4VectorMemAccessType::SCALAR;
-      return ret;
-    };
-  } else if (eq_any(instr_name, "sc_d", "sc_w")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::SC };
-      ret.memory_access_type = G4VectorMemAccessType::SCALAR;
-      ret.S_base_reg = g4trace_regid_x(insn.rs1());
-      ret.S_data_reg= g4trace_regid_x(insn.rs2());
-      return ret;
-    };
-  } else if (eq_any(instr_name,
-                    "amoadd_d", "amoadd_w", "amoand_d", "amoand_w", "amomax_d", "amomaxu_d", "amomaxu_w", "amomax_w", "amomin_d",
-                    "amominu_d", "amominu_w", "amomin_w", "amoor_d", "amoor_w", "amoswap_d", "amoswap_w", "amoxor_d", "amoxor_w",
-                    "amoadd_h", "amoand_b", "amoand_h", "amocas_b", "amocas_d", "amocas_h", "amocas_q", "amocas_w", "amomax_b",
-                    "amomax_h", "amomaxu_b", "amomaxu_h", "amomin_b", "amomin_h", "amominu_b", "amominu_h", "amoor_b", "amoor_h",
-                    "amoswap_b", "amoswap_h", "amoxor_b", "amoxor_h")) {
-    return [](DECODER_ARGS) {
-      G4InstInfo ret { G4InstType::RMW };
-      ret.memory_access_type = G4VectorMemAccessType::SCALAR;
-      ret.S_base_reg = g4trace_regid_x(insn.rs1());
-      ret.S_data_reg= g4trace_regid_x(insn.rs2());
-      return ret;
-    };
-
-  } else if (eq_any(instr_name,
-                    "fence", "fence_i")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::GENERIC }; };
-  } else if (eq_any(instr_name,
-                    "fmadd_d", "fmadd_h", "fmadd_q", "fmadd_s", "fmsub_d", "fmsub_h", "fmsub_q", "fmsub_s",
-                    "fnmadd_d", "fnmadd_h", "fnmadd_q", "fnmadd_s", "fnmsub_d", "fnmsub_h", "fnmsub_q", "fnmsub_s")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::M }; };
-  } else if (eq_any(instr_name,
-                    "fmul_d", "fmul_h", "fmul_q", "fmul_s",
-                    "vfmul_vf", "vfmul_vv", "vfwmul_vf", "vfwmul_vv")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::M }; };
-  } else if (eq_any(instr_name,
-                    "clmulh", "clmul", "clmulr", "c_mul", "mulh", "mulhsu", "mulhu", "mul", "mulw",
-                    "vclmulh_vv", "vclmulh_vx", "vclmul_vv", "vclmul_vx", "vmulhsu_vv", "vmulhsu_vx",
-                    "vmulhu_vv", "vmulhu_vx", "vmulh_vv", "vmulh_vx", "vmul_vv", "vmul_vx", "vsmul_vv",
-                    "vsmul_vx", "vwmulsu_vv", "vwmulsu_vx", "vwmulu_vv", "vwmulu_vx", "vwmul_vv",
-                    "vwmul_vx")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::GENERIC }; };
-  } else if (eq_any(instr_name,
-                    "fdiv_s", "fdiv_d", "fdiv_q", "fdiv_h",
-                    "vfdiv_vf", "vfdiv_vv", "vfrdiv_vf")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::D }; };
-  } else if (eq_any(instr_name,
-                    "div", "divu", "divuw", "divw", 
-                    "rem", "remu", "remuw", "remw", 
-                    "vdiv_vv", "vdiv_vx", "vdivu_vv", "vdivu_vx"
-                    "vrem_vv", "vrem_vx", "vremu_vv", "vremu_vx")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::GENERIC }; };
-  } else if (eq_any(instr_name,
-                    "fadd_d", "fadd_h", "fadd_q", "fadd_s",
-                    "vfadd_vf", "vfadd_vv",
-                    "vfredosum_vs", "vfredusum_vs",
-                    "fsub_s", "fsub_d", "fsub_q", "fsub_h",
-                    "vfsub_vf", "vfsub_vv",
-                    "feq_s", "feq_d", "feq_q", "feq_h", "vmfeq_vf", "vmfeq_vv" // Maybe these should be GENERIC
-               )) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::A }; };
-  } else if (eq_any(instr_name,
-                    "fsqrt_s", "fsqrt_d", "vfrsqrt7_v", "vfsqrt_v", "fsqrt_q", "fsqrt_h")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::Q }; };
-  } else if (eq_any(instr_name,
-                    "fmv_w_x", "fmv_x_w", "fmv_d_x", "fmv_x_d", "fmvh_x_d", "fmvp_d_x", "fmvh_x_q", "fmvp_q_x", "fmv_h_x", "fmv_x_h",
-                    "fcvt_l_h", "fcvt_lu_h", "fcvt_d_h", "fcvt_h_d", "fcvt_h_l", "fcvt_h_lu", "fcvt_h_q",
-                    "fcvt_h_s", "fcvt_h_w", "fcvt_h_wu", "fcvt_q_h", "fcvt_s_h", "fcvt_w_h", "fcvt_wu_h",
-                    "fcvt_l_s", "fcvt_lu_s", "fcvt_s_l", "fcvt_s_lu", "fcvt_s_w", "fcvt_s_wu", "fcvt_w_s",
-                    "fcvt_wu_s", "fcvt_d_l", "fcvt_d_lu", "fcvt_d_q", "fcvt_d_s", "fcvt_d_w", "fcvt_d_wu",
-                    "fcvt_l_d", "fcvt_lu_d", "fcvt_s_d", "fcvt_w_d", "fcvt_wu_d",
-                    "fle_s", "flt_s", "fle_d", "flt_d", "fleq_d", "fltq_d", "fleq_s", "fltq_s", "fle_q",
-                    "flt_q", "fleq_q", "fltq_q", "fle_h", "flt_h", "fleq_h", "fltq_h",
-                    "fsgnj_s", "fsgnjn_s", "fsgnjx_s", "fsgnj_d", "fsgnjn_d", "fsgnjx_d", "fsgnj_q", "fsgnjn_q",
-                    "fsgnjx_q", "fsgnj_h", "fsgnjn_h", "fsgnjx_h")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::GENERIC }; };    
-  } else if (eq_any(instr_name, "vsetivli", "vsetvli", "vsetvl")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::GENERIC }; };
-  } else if (eq_any(instr_name,
-                    "vfmv_f_s", "vfmv_s_f", "vfmv_v_f", "vfncvt_f_f_w", "vfncvt_f_x_w", "vfncvt_f_xu_w", "vfncvt_rod_f_f_w",
-                    "vfncvt_rtz_x_f_w", "vfncvt_rtz_xu_f_w", "vfncvt_x_f_w", "vfncvt_xu_f_w",
-                    "vfcvt_f_x_v", "vfcvt_f_xu_v", "vfcvt_rtz_x_f_v", "vfcvt_rtz_xu_f_v", "vfcvt_x_f_v", "vfcvt_xu_f_v", 
-                    "vfwcvt_f_f_v", "vfwcvt_f_x_v", "vfwcvt_f_xu_v", "vfwcvt_rtz_x_f_v", "vfwcvt_rtz_xu_f_v", "vfwcvt_x_f_v", "vfwcvt_xu_f_v", 
-                    "vmv1r_v", "vmv2r_v", "vmv4r_v", "vmv8r_v", "vmv_s_x", "vmv_v_i", "vmv_v_v", "vmv_v_x", "vmv_x_s",
-                    "vid_v", "viota_m",
-                    "vor_vi", "vor_vv", "vor_vx", "vandn_vv", "vandn_vx", "vand_vi", "vand_vv", "vand_vx", "vxor_vi", "vxor_vv", "vxor_vx", 
-                    "vredand_vs", "vredmax_vs", "vredmaxu_vs", "vredmin_vs", "vredminu_vs", "vredor_vs", "vredsum_vs", "vredxor_vs", 
-                    "vadd_vi", "vadd_vv", "vadd_vx", "vsub_vv", "vsub_vx", "vrsub_vi", "vrsub_vx", 
-                    "vwadd_vv", "vwadd_vx", "vwadd_wv", "vwadd_wx", "vwaddu_vv", "vwaddu_vx", "vwaddu_wv", "vwaddu_wx", "vwmacc_vv",
-                    "vwmacc_vx", "vwmaccsu_vv", "vwmaccsu_vx", "vwmaccu_vv", "vwmaccu_vx", "vwmaccus_vx", "vasub_vv", "vasubu_vv",
-                    "vasub_vx", "vasubu_vx",
-                    "vsll_vi", "vsll_vv", "vsll_vx", "vsra_vi", "vsra_vv", "vsra_vx", "vsrl_vi", "vsrl_vv", "vsrl_vx", "vssra_vi",
-                    "vssra_vv", "vssra_vx", "vssrl_vi", "vssrl_vv", "vssrl_vx", "vssub_vv", "vssub_vx", "vssubu_vv", "vssubu_vx", 
-                    "vsext_vf2", "vsext_vf4", "vsext_vf8",
-                    "vslide1down_vx", "vslide1up_vx", "vslidedown_vi", "vslidedown_vx", "vslideup_vi", "vslideup_vx", 
-                    "vsadd_vi", "vsadd_vv", "vsadd_vx", "vsaddu_vi", "vsaddu_vv", "vsaddu_vx", "vsbc_vvm", "vsbc_vxm", 
-                    "vmacc_vv", "vmacc_vx", "vmadc_vv", "vmadc_vx", "vmadc_vi", "vmadc_vim", "vmadc_vvm",
-                    "vmadc_vxm", "vmadd_vv", "vmadd_vx",
-                    "vmand_mm", "vmandn_mm", "vmax_vv", "vmax_vx", "vmaxu_vv", "vmaxu_vx",
-                    "vmin_vv", "vmin_vx", "vminu_vv", "vminu_vx", "vmnand_mm", "vmnor_mm", "vmor_mm", "vmorn_mm",
-                    "vmsbc_vv", "vmsbc_vx", "vmsbc_vvm", "vmsbc_vxm", "vmsbf_m", "vmseq_vi", "vmseq_vv", "vmseq_vx",
-                    "vmsgt_vi", "vmsgt_vx", "vmsgtu_vi", "vmsgtu_vx", "vmsif_m", "vmsle_vi", "vmsle_vv", "vmsle_vx",
-                    "vmsleu_vi", "vmsleu_vv", "vmsleu_vx", "vmslt_vv", "vmslt_vx", "vmsltu_vv", "vmsltu_vx", "vmsne_vi",
-                    "vmsne_vv", "vmsne_vx", "vmsof_m",
-                    "vmerge_vim", "vmerge_vvm", "vmerge_vxm", "vfirst_m",
-                    "vmfle_vf", "vmfle_vv", "vmflt_vf", "vmflt_vv", "vfsgnj_vf", "vfsgnj_vv", "vfsgnjn_vf",
-                    "vfsgnjn_vv", "vfsgnjx_vf", "vfsgnjx_vv",
-                    "vrgather_vi", "vrgather_vv", "vrgather_vx", "vrgatherei16_vv",
-                    "vfslide1down_vf", "vfslide1up_vf", "vcompress_vm",
-                    "vnsra_wi", "vnsra_wv", "vnsra_wx", "vnsrl_wi", "vnsrl_wv", "vnsrl_wx")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::GENERIC }; };
-  } else if (eq_any(instr_name,
-                    "vfmacc_vf", "vfmacc_vv", "vfmadd_vf", "vfmadd_vv", "vfnmacc_vf", "vfnmacc_vv",
-                    "vfnmadd_vf", "vfnmadd_vv", "vfnmsac_vf", "vfnmsac_vv", "vfnmsub_vf", "vfnmsub_vv",
-                    "vfmsac_vf", "vfmsac_vv", "vfmsub_vf", "vfmsub_vv")) {
-
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::M }; };
-  } else if (eq_any(instr_name,
-                    "csrrc", "csrrci", "csrrs", "csrrsi", "csrrw", "csrrwi")) {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::GENERIC }; };
+#define DECODER_ARGS processor_t UNUSED *p, reg_t UNUSED pc, insn_t UNUSED insn
+
+static G4InstInfo g4trace_decode_srai(DECODER_ARGS) {
+  if (insn.bits() == 0x40205013 /* srai zero, zero, 2 */) {
+    return G4InstInfo { G4InstType::START_TRACING };
+  } else if (insn.bits() == 0x40005013 /* srai zero, zero, 0 */) {
+    return G4InstInfo { G4InstType::CLEAR };   // ROI start
+  } else if (insn.bits() == 0x40105013 /* srai zero, zero, 1 */) {
+    return G4InstInfo { G4InstType::END_ROI };   // ROI end
   } else {
-    return [](DECODER_ARGS) { return G4InstInfo { G4InstType::UNKNOWN }; };        
+    return G4InstInfo { G4InstType::GENERIC };
   }
-#undef DECODER_ARGS
 }
 
-G4TraceDecoder g4trace_get_decoder(const string& instr_name) {
-  auto ret = g4trace_get_decoder_internal(instr_name);
-  //printf("G4TraceDecoder:\t%s\t%p\n", instr_name.c_str(), ret);
+static G4InstInfo g4trace_decode_unknown(DECODER_ARGS) { return G4InstInfo { G4InstType::UNKNOWN }; }
+static G4InstInfo g4trace_decode_generic(DECODER_ARGS) { return G4InstInfo { G4InstType::GENERIC }; }
+static G4InstInfo g4trace_decode_fp_add(DECODER_ARGS) { return G4InstInfo { G4InstType::A }; }
+static G4InstInfo g4trace_decode_fp_mul(DECODER_ARGS) { return G4InstInfo { G4InstType::M }; }
+static G4InstInfo g4trace_decode_fp_div(DECODER_ARGS) { return G4InstInfo { G4InstType::D }; }
+static G4InstInfo g4trace_decode_fp_sqrt(DECODER_ARGS) { return G4InstInfo { G4InstType::Q }; }
+
+static G4InstInfo g4trace_decode_branch(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::B };
+  ret.target_address = pc + insn.sb_imm();
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_c_branch(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::B };
+  ret.target_address = pc + insn.rvc_b_imm();
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_c_j(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::J };
+  ret.target_address = pc + insn.rvc_j_imm();
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_c_jr(DECODER_ARGS) {
+  G4InstInfo ret;
+  if ((insn.rvc_rs1() == 1 || insn.rvc_rs1() == 5) && insn.rvc_imm() == 0) {
+    ret.type = G4InstType::r;
+  } else {
+    ret.type = G4InstType::j;
+  }
+  ret.target_address = commit_log_read_value_xpr(p, insn.rvc_rs1()) & ~reg_t(1);
+  return ret;
+}
+
+// c_jal is actually c.addiw (difference between RV32 an RV64 and spike weirdness)
+static G4InstInfo g4trace_decode_c_addiw(DECODER_ARGS) {
+  assert(insn.rvc_rd() != 0);
+  return G4InstInfo { G4InstType::GENERIC };
+}
+
+static G4InstInfo g4trace_decode_jal(DECODER_ARGS) {
+  G4InstInfo ret;
+  if (insn.rd() == 0) {
+    ret.type = G4InstType::J; // J pseudoinstruction
+  } else {
+    assert((insn.rd() == 1 || insn.rd() == 5) || "JAL with unexpected destination register. Probably should be treated as J.");
+    ret.type = G4InstType::C;
+  }
+  ret.target_address = pc + insn.uj_imm();
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_jalr(DECODER_ARGS) {
+  G4InstInfo ret;
+  bool rdislink = insn.rd() == 1 || insn.rd() == 5;
+  bool rs1islink = insn.rs1() == 1 || insn.rs1() == 5;
+  if (!rdislink && rs1islink) {
+    ret.type = G4InstType::r; // ret
+  } else {
+    ret.type = G4InstType::c;
+  }
+  ret.target_address = (commit_log_read_value_xpr(p, insn.rs1()) + insn.i_imm()) & ~reg_t(1);
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_c_jalr(DECODER_ARGS) {
+  G4InstInfo ret;
+  ret.type = G4InstType::c;
+  ret.target_address = commit_log_read_value_xpr(p, insn.rvc_rs1()) & ~reg_t(1);
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_load(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::L };
+  ret.memory_access_type = g4trace_decode_mem_access_type(insn);
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_c_load(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::L };
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_c_store(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::S };
+  auto first3bits = (insn.bits() & 0xe000) >> 13;
+  ret.S_base_reg = g4trace_regid_x(insn.rvc_rs1s());
+  ret.S_data_reg =
+    first3bits == 0x5 ? g4trace_regid_f(insn.rvc_rs2s()) // FSD
+    : first3bits == 0x6 ? g4trace_regid_x(insn.rvc_rs2s()) // SW
+    : first3bits == 0x7 ? g4trace_regid_x(insn.rvc_rs2s()) // SD
+    : g4trace_regid_invalid;
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_c_store_sp(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::S };
+  auto first3bits = (insn.bits() & 0xe000) >> 13;
+  ret.S_base_reg = g4trace_regid_x(2); // sp, x2
+  ret.S_data_reg =
+    first3bits == 0x5 ? g4trace_regid_f(insn.rvc_rs2()) // s_fsdsp
+    : first3bits == 0x6 ? g4trace_regid_x(insn.rvc_rs2()) // c_swsp
+    : first3bits == 0x7 ? g4trace_regid_x(insn.rvc_rs2()) // c_sdsp
+    : g4trace_regid_invalid;
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  return ret;
+}
+
+// c.sb and c.sh (Zcb)
+static G4InstInfo g4trace_decode_c_int_store(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::S };
+  ret.S_base_reg = g4trace_regid_x(insn.rvc_rs1s());
+  ret.S_data_reg = g4trace_regid_x(insn.rvc_rs2s());
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  return ret;
+}
+
+// c.fsw (RV32), which shares its encoding with c.sd
+static G4InstInfo g4trace_decode_c_fp_store(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::S };
+  ret.S_base_reg = g4trace_regid_x(insn.rvc_rs1s());
+  ret.S_data_reg = g4trace_regid_f(insn.rvc_rs2s());
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  return ret;
+}
+
+// c.fswsp (RV32), which shares its encoding with c.sdsp
+static G4InstInfo g4trace_decode_c_fp_store_sp(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::S };
+  ret.S_base_reg = g4trace_regid_x(2); // sp, x2
+  ret.S_data_reg = g4trace_regid_f(insn.rvc_rs2());
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_store(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::S };
+  ret.S_base_reg = g4trace_regid_x(insn.rs1());
+  ret.memory_access_type = g4trace_decode_mem_access_type(insn);
+  if (ret.memory_access_type == G4VectorMemAccessType::SCALAR) {
+    ret.S_data_reg = g4trace_regid_x(insn.rs2());
+  } else {
+    ret.S_data_reg = g4trace_regid_v(insn.rd());  // TODO: this is not correct for Vector Store Whole Register instructions that write more than one register (vs2r_v vs4r_v vs8r_v) and Vector Store Segment Instructions 
+  }
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_fp_store(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::S };
+  ret.S_base_reg = g4trace_regid_x(insn.rs1());
+  ret.memory_access_type = g4trace_decode_mem_access_type(insn);
+  if (ret.memory_access_type == G4VectorMemAccessType::SCALAR) {
+    ret.S_data_reg = g4trace_regid_f(insn.rs2());
+  } else {
+    ret.S_data_reg = g4trace_regid_v(insn.rd());  // Actually covered in the integer store case
+  }
   return ret;
 }
 
-static void g4trace_print_memory_access_addresses(const commit_log_mem_t& accesses, const G4InstInfo& g4i, ostream *out) {
+static G4InstInfo g4trace_decode_lr(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::LR };
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_sc(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::SC };
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  ret.S_base_reg = g4trace_regid_x(insn.rs1());
+  ret.S_data_reg= g4trace_regid_x(insn.rs2());
+  return ret;
+}
+
+// lb.aq, lh.aq, lw.aq and ld.aq (Zalasr)
+static G4InstInfo g4trace_decode_load_acquire(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::LA };
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  return ret;
+}
+
+// sb.rl, sh.rl, sw.rl and sd.rl (Zalasr)
+static G4InstInfo g4trace_decode_store_release(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::SA };
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  ret.S_base_reg = g4trace_regid_x(insn.rs1());
+  ret.S_data_reg= g4trace_regid_x(insn.rs2());
+  return ret;
+}
+
+static G4InstInfo g4trace_decode_amo(DECODER_ARGS) {
+  G4InstInfo ret { G4InstType::RMW };
+  ret.memory_access_type = G4VectorMemAccessType::SCALAR;
+  ret.S_base_reg = g4trace_regid_x(insn.rs1());
+  ret.S_data_reg= g4trace_regid_x(insn.rs2());
+  return ret;
+}
+
+#undef DECODER_ARGS
+
+G4TraceDecoder g4trace_get_decoder(const string& instr_name) {
+  static const unordered_map<string, G4TraceDecoder> decoders = {
+#define G4TRACE_INSN(name, decoder) { #name, g4trace_decode_##decoder },
+#include "g4trace_insns.h"
+#undef G4TRACE_INSN
+  };
+  auto i = decoders.find(instr_name);
+  return i == decoders.end() ? g4trace_decode_unknown : i->second;
+}
+
+static const char *g4trace_type_prefix(G4InstType type) {
+  switch (type) {
+    case G4InstType::GENERIC: return "";
+    case G4InstType::A: return "A";
+    case G4InstType::M: return "M";
+    case G4InstType::D: return "D";
+    case G4InstType::Q: return "Q";
+    case G4InstType::L: return "L";
+    case G4InstType::LA: return "LA";
+    case G4InstType::LR: return "LA"; // TODO: should be LR, but gems4proc does not yet support it
+    case G4InstType::S: return "S";
+    case G4InstType::SA: return "SA";
+    case G4InstType::SC: return "SA"; // TODO: should be SC, but gems4proc does not yet support it
+    case G4InstType::RMW: return "RMW";
+    case G4InstType::B: return "B";
+    case G4InstType::C: return "C";
+    case G4InstType::J: return "J";
+    case G4InstType::j: return "j";
+    case G4InstType::r: return "r";
+    case G4InstType::c: return "c";
+    default: return "UNKNOWN";
+  }
+}
+
+// Register operands of a traced instruction. Ids are unique within a list
+// and CSRs/vstatus are filtered, so one slot per x, f and v register is enough.
+struct G4TraceRegList {
+  static const int capacity = 96;
+  int size = 0;
+  G4TraceRegId ids[capacity];
+  void push_back(G4TraceRegId r) { assert(size < capacity); ids[size++] = r; }
+};
+
+// Everything printed for one instruction line, independent of the output format.
+struct G4TraceInstRecord {
+  G4InstType type = G4InstType::INVALID;
+  int64_t diffpc = 0;
+  G4TraceRegList x, y, z;
+  G4VectorMemAccessType memory_access_type = G4VectorMemAccessType::INVALID;
+  const commit_log_mem_t *loads = nullptr;
+  const commit_log_mem_t *stores = nullptr;
+  bool has_target = false;
+  int64_t target_offset = 0; // target address - pc
+  bool target_from_setpc = false; // printed as "*" after the target of a B instruction
+};
+
+static void g4trace_print_memory_access_addresses(const commit_log_mem_t& accesses, G4VectorMemAccessType memory_access_type, ostream *out) {
   const auto& first = *accesses.begin();
   auto addr_first = get<0>(first);
   int size = get<2>(first);
@@ -386,17 +360,17 @@ static void g4trace_print_memory_access_addresses(const commit_log_mem_t& access
   }
   auto num_items = accesses.size();
 
-  if (g4i.memory_access_type ==  G4VectorMemAccessType::SCALAR) {
+  if (memory_access_type ==  G4VectorMemAccessType::SCALAR) {
     assert(num_items == 1);
     *out << " " << hex << addr_first << " " << dec << size;
-  } else if (g4i.memory_access_type ==  G4VectorMemAccessType::CONTIGUOUS) {
+  } else if (memory_access_type ==  G4VectorMemAccessType::CONTIGUOUS) {
     *out << "s" << size << "e" << num_items << " " << hex << addr_first << " " << dec;
-  } else if (g4i.memory_access_type ==  G4VectorMemAccessType::STRIDED) {
+  } else if (memory_access_type ==  G4VectorMemAccessType::STRIDED) {
     int stride = num_items > 1
       ? get<0>(accesses[1]) - get<0>(accesses[0])
       : 0;
     *out << "s" << size << "e" << num_items << " " << hex << addr_first  << dec << "+" << stride << " ";
-  } else if (g4i.memory_access_type ==  G4VectorMemAccessType::INDEXED) {
+  } else if (memory_access_type ==  G4VectorMemAccessType::INDEXED) {
     *out << "s" << size << "e" << num_items;
     for (auto i = accesses.cbegin(); i != accesses.cend(); i++) {
       if (i != accesses.cbegin()) {
@@ -406,7 +380,7 @@ static void g4trace_print_memory_access_addresses(const commit_log_mem_t& access
     }
     *out << dec;
   } else {
-    *out << " TODO access_tcype=" << (int) g4i.memory_access_type << " ";
+    *out << " TODO access_tcype=" << (int) memory_access_type << " ";
     for (auto item : accesses) {
       auto addr = get<0>(item);
       int size = get<2>(item);
@@ -415,6 +389,492 @@ static void g4trace_print_memory_access_addresses(const commit_log_mem_t& access
   }
 }
 
+static void g4trace_print_text_inst(const G4TraceInstRecord& r, ostream *out) {
+  *out << g4trace_type_prefix(r.type) << r.diffpc;
+  for (int i = 0; i < r.x.size; i++)
+    *out << "x" << r.x.ids[i].id;
+  for (int i = 0; i < r.y.size; i++)
+    *out << "y" << r.y.ids[i].id;
+  for (int i = 0; i < r.z.size; i++)
+    *out << "z" << r.z.ids[i].id;
+  if (r.loads && !r.loads->empty())
+    g4trace_print_memory_access_addresses(*r.loads, r.memory_access_type, out);
+  if (r.stores && !r.stores->empty())
+    g4trace_print_memory_access_addresses(*r.stores, r.memory_access_type, out);
+  if (r.has_target) {
+    *out << "t" << r.target_offset;
+    if (r.target_from_setpc)
+      *out << "*";
+  }
+  *out << '\n';
+}
+
+// Binary format (--log-g4trace-format=binary)
+//
+// The file starts with g4trace_binary_magic followed by a version byte. Each
+// record starts with a tag byte. Tags below g4trace_binary_tag_start are
+// instructions: the low 6 bits hold the G4InstType, bit 6 is set when a
+// branch target follows and bit 7 when the target has the "*" mark.
+//
+// Instruction records continue with the pc delta (zigzag varint) and a count
+// byte holding 2 bits per list (x, y, z, memory groups). A count of 3 means
+// that the actual count follows as a varint. Then come the register ids
+// (varints), the memory groups and the target offset (zigzag varint). A
+// memory group is the access type byte, the element size, the number of
+// elements and the addresses, each zigzag delta encoded against the previous
+// address in the file. Strided groups store the first address and the stride,
+// contiguous groups only the first address.
+static const char g4trace_binary_magic[4] = { 'G', '4', 'T', 'B' };
+static const uint8_t g4trace_binary_version = 1;
+static const uint8_t g4trace_binary_tag_start = 0x3c;   // absolute pc as varint
+static const uint8_t g4trace_binary_tag_clear = 0x3d;
+static const uint8_t g4trace_binary_tag_end = 0x3e;     // absolute pc as varint
+static const uint8_t g4trace_binary_tag_comment = 0x3f; // length as varint, then the characters
+static const uint8_t g4trace_binary_has_target = 0x40;
+static const uint8_t g4trace_binary_target_from_setpc = 0x80;
+static_assert(int(G4InstType::CV_WAIT) < g4trace_binary_tag_start);
+
+static void g4trace_put_varint(vector<uint8_t>& buf, uint64_t v) {
+  while (v >= 0x80) {
+    buf.push_back(uint8_t(v) | 0x80);
+    v >>= 7;
+  }
+  buf.push_back(uint8_t(v));
+}
+
+static void g4trace_put_svarint(vector<uint8_t>& buf, int64_t v) {
+  g4trace_put_varint(buf, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+}
+
+static bool g4trace_get_varint(istream& in, uint64_t& v) {
+  v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = in.get();
+    if (c == EOF)
+      return false;
+    v |= uint64_t(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static bool g4trace_get_svarint(istream& in, int64_t& v) {
+  uint64_t u;
+  if (!g4trace_get_varint(in, u))
+    return false;
+  v = int64_t(u >> 1) ^ -int64_t(u & 1);
+  return true;
+}
+
+static void g4trace_put_mem_group(vector<uint8_t>& buf, const commit_log_mem_t& accesses, G4VectorMemAccessType memory_access_type, reg_t& last_addr) {
+  buf.push_back(uint8_t(memory_access_type));
+  g4trace_put_varint(buf, get<2>(accesses[0]));
+  g4trace_put_varint(buf, accesses.size());
+  g4trace_put_svarint(buf, get<0>(accesses[0]) - last_addr);
+  last_addr = get<0>(accesses[0]);
+  if (memory_access_type == G4VectorMemAccessType::SCALAR
+      || memory_access_type == G4VectorMemAccessType::CONTIGUOUS) {
+    // only the first address is printed
+  } else if (memory_access_type == G4VectorMemAccessType::STRIDED) {
+    int stride = accesses.size() > 1
+      ? get<0>(accesses[1]) - get<0>(accesses[0])
+      : 0;
+    g4trace_put_svarint(buf, stride);
+  } else {
+    for (size_t i = 1; i < accesses.size(); i++) {
+      g4trace_put_svarint(buf, get<0>(accesses[i]) - last_addr);
+      last_addr = get<0>(accesses[i]);
+    }
+  }
+}
+
+static bool g4trace_get_mem_group(istream& in, commit_log_mem_t& accesses, G4VectorMemAccessType& memory_access_type, reg_t& last_addr) {
+  int type = in.get();
+  uint64_t size, count;
+  int64_t delta;
+  if (type == EOF || !g4trace_get_varint(in, size) || !g4trace_get_varint(in, count) || count == 0
+      || !g4trace_get_svarint(in, delta))
+    return false;
+  memory_access_type = G4VectorMemAccessType(type);
+  last_addr += delta;
+  accesses.clear();
+  accesses.emplace_back(last_addr, 0, size);
+  if (memory_access_type == G4VectorMemAccessType::SCALAR
+      || memory_access_type == G4VectorMemAccessType::CONTIGUOUS) {
+    for (uint64_t i = 1; i < count; i++)
+      accesses.emplace_back(last_addr + i * size, 0, size);
+  } else if (memory_access_type == G4VectorMemAccessType::STRIDED) {
+    int64_t stride;
+    if (!g4trace_get_svarint(in, stride))
+      return false;
+    for (uint64_t i = 1; i < count; i++)
+      accesses.emplace_back(last_addr + i * stride, 0, size);
+  } else {
+    for (uint64_t i = 1; i < count; i++) {
+      if (!g4trace_get_svarint(in, delta))
+        return false;
+      last_addr += delta;
+      accesses.emplace_back(last_addr, 0, size);
+    }
+  }
+  return true;
+}
+
+static void g4trace_put_binary_inst(G4TracePerProcState& s, const G4TraceInstRecord& r) {
+  auto& buf = s.record_buf;
+  buf.clear();
+
+  int nmem = (r.loads && !r.loads->empty()) + (r.stores && !r.stores->empty());
+  uint8_t tag = uint8_t(r.type);
+  if (r.has_target)
+    tag |= g4trace_binary_has_target;
+  if (r.target_from_setpc)
+    tag |= g4trace_binary_target_from_setpc;
+  buf.push_back(tag);
+  g4trace_put_svarint(buf, r.diffpc);
+
+  int counts[] = { r.x.size, r.y.size, r.z.size, nmem };
+  uint8_t counts_byte = 0;
+  for (int i = 0; i < 4; i++)
+    counts_byte |= min(counts[i], 3) << (2 * i);
+  buf.push_back(counts_byte);
+  for (int i = 0; i < 4; i++)
+    if (counts[i] >= 3)
+      g4trace_put_varint(buf, counts[i]);
+
+  for (const G4TraceRegList *l : { &r.x, &r.y, &r.z })
+    for (int i = 0; i < l->size; i++)
+      g4trace_put_varint(buf, l->ids[i].id);
+
+  if (r.loads && !r.loads->empty())
+    g4trace_put_mem_group(buf, *r.loads, r.memory_access_type, s.last_mem_addr);
+  if (r.stores && !r.stores->empty())
+    g4trace_put_mem_group(buf, *r.stores, r.memory_access_type, s.last_mem_addr);
+
+  if (r.has_target)
+    g4trace_put_svarint(buf, r.target_offset);
+
+  s.out->write((const char *) buf.data(), buf.size());
+}
+
+static void g4trace_put_binary_pc(G4TracePerProcState& s, uint8_t tag, reg_t pc) {
+  auto& buf = s.record_buf;
+  buf.clear();
+  buf.push_back(tag);
+  if (tag != g4trace_binary_tag_clear)
+    g4trace_put_varint(buf, pc);
+  s.out->write((const char *) buf.data(), buf.size());
+}
+
+// The g4trace_write_* functions format records into s.out. They run on the
+// simulating thread, or on the writer thread of the trace when there is one.
+
+static void g4trace_write_frame(G4TracePerProcState& s, G4TraceFrameKind kind, uint64_t first_instruction, reg_t lastpc) {
+  uint64_t offset;
+  if (auto z = dynamic_cast<ZstdOStream *>(s.out)) {
+    offset = z->start_frame();
+  } else if (auto l = dynamic_cast<LzmaOStream *>(s.out)) {
+    offset = l->start_frame();
+  } else if (auto a = dynamic_cast<AsyncOStream *>(s.out)) {
+    a->start_frame();
+    offset = g4trace_unknown_frame_offset; // filled in by g4trace_close_trace_file
+  } else {
+    s.out->flush();
+    offset = s.out->tellp();
+  }
+  s.frames->push_back({ kind, first_instruction, offset, lastpc, s.last_mem_addr });
+}
+
+static void g4trace_write_start(G4TracePerProcState& s, reg_t pc) {
+  if (s.global->format == G4TraceFormat::BINARY)
+    g4trace_put_binary_pc(s, g4trace_binary_tag_start, pc);
+  else
+    *s.out << hex << pc << dec << "\n";
+}
+
+static void g4trace_write_clear(G4TracePerProcState& s) {
+  if (s.global->format == G4TraceFormat::BINARY)
+    g4trace_put_binary_pc(s, g4trace_binary_tag_clear, 0);
+  else
+    *s.out << "CLEAR\n";
+}
+
+static void g4trace_write_end(G4TracePerProcState& s, reg_t pc) {
+  if (s.global->format == G4TraceFormat::BINARY) {
+    g4trace_put_binary_pc(s, g4trace_binary_tag_end, pc);
+    s.out->flush();
+  } else {
+    *s.out << "END " << hex << pc << dec << endl;
+  }
+}
+
+static void g4trace_write_comment(G4TracePerProcState& s, const string& comment) {
+  if (s.global->format == G4TraceFormat::BINARY) {
+    auto& buf = s.record_buf;
+    buf.clear();
+    buf.push_back(g4trace_binary_tag_comment);
+    g4trace_put_varint(buf, comment.size());
+    buf.insert(buf.end(), comment.begin(), comment.end());
+    s.out->write((const char *) buf.data(), buf.size());
+  } else {
+    *s.out << "{ " << left << setw(32) << comment << " } ";
+  }
+  s.out->flush(); // TODO remove this, now here to ensure output is complete in case of assert.
+}
+
+static void g4trace_write_inst(G4TracePerProcState& s, const G4TraceInstRecord& r) {
+  if (s.global->format == G4TraceFormat::BINARY)
+    g4trace_put_binary_inst(s, r);
+  else
+    g4trace_print_text_inst(r, s.out);
+}
+
+// Writer thread of a trace (--log-g4trace-writer-threads)
+//
+// The simulating thread serializes the records (the operands and memory
+// accesses collected by g4trace_trace_inst, not formatted text) into large
+// blocks. Full blocks go through a bounded single-producer single-consumer
+// ring to the writer thread, which formats them with the g4trace_write_*
+// functions, so the output is the same as without the thread. From its
+// creation until finish(), the writer owns s.out, s.last_mem_addr,
+// s.record_buf and s.frames.
+class G4TraceWriter {
+public:
+  enum class Msg : uint8_t { INST, START, CLEAR, END, COMMENT, FRAME, EXIT };
+
+  G4TraceWriter(G4TracePerProcState& s) : s(s) {
+    for (auto& b : blocks)
+      b.reserve(block_size + block_slack);
+    thread = std::thread(&G4TraceWriter::run, this);
+  }
+
+  template<typename T>
+  void put(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    put_bytes(&value, sizeof(T));
+  }
+
+  void put_bytes(const void *data, size_t len) {
+    auto& b = blocks[produced % num_blocks];
+    size_t n = b.size();
+    b.resize(n + len);
+    memcpy(b.data() + n, data, len);
+  }
+
+  // Called after each message
+  void end_message() {
+    if (blocks[produced % num_blocks].size() >= block_size)
+      flush();
+  }
+
+  // Hands the current block to the writer thread
+  void flush() {
+    if (blocks[produced % num_blocks].empty())
+      return;
+    full_blocks.release();
+    produced++;
+    if (!free_blocks.try_acquire()) {
+      ++s.writer_stalls;
+      free_blocks.acquire();
+    }
+    blocks[produced % num_blocks].clear();
+  }
+
+  // Writes everything and stops the thread
+  void finish() {
+    put(Msg::EXIT);
+    flush();
+    thread.join();
+  }
+
+private:
+  static const size_t block_size = 1 << 18;
+  static const size_t block_slack = 1 << 12; // a message rarely exceeds this
+  static const size_t num_blocks = 16;
+
+  G4TracePerProcState& s;
+  std::vector<uint8_t> blocks[num_blocks];
+  size_t produced = 0; // blocks handed to the writer, only used by the simulating thread
+  std::counting_semaphore<num_blocks> full_blocks{0};
+  std::counting_semaphore<num_blocks> free_blocks{num_blocks - 1}; // the producer owns one block
+  std::thread thread;
+
+  template<typename T>
+  static T get(const uint8_t *&p) {
+    T value;
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+  }
+
+  static void get_accesses(const uint8_t *&p, commit_log_mem_t& accesses) {
+    accesses.clear();
+    for (auto n = get<uint32_t>(p); n > 0; n--) {
+      auto addr = get<reg_t>(p);
+      accesses.emplace_back(addr, 0, get<uint8_t>(p));
+    }
+  }
+
+  void run() {
+    commit_log_mem_t loads, stores;
+    string comment;
+    for (size_t consumed = 0; ; consumed++) {
+      full_blocks.acquire();
+      const auto& b = blocks[consumed % num_blocks];
+      for (const uint8_t *p = b.data(); p < b.data() + b.size(); ) {
+        switch (get<Msg>(p)) {
+          case Msg::INST: {
+            G4TraceInstRecord r;
+            r.type = get<G4InstType>(p);
+            r.memory_access_type = get<G4VectorMemAccessType>(p);
+            r.diffpc = get<int64_t>(p);
+            r.target_offset = get<int64_t>(p);
+            auto flags = get<uint8_t>(p);
+            r.has_target = flags & 1;
+            r.target_from_setpc = flags & 2;
+            for (G4TraceRegList *l : { &r.x, &r.y, &r.z }) {
+              l->size = get<uint8_t>(p);
+              memcpy(l->ids, p, l->size * sizeof(G4TraceRegId));
+              p += l->size * sizeof(G4TraceRegId);
+            }
+            get_accesses(p, loads);
+            get_accesses(p, stores);
+            r.loads = &loads;
+            r.stores = &stores;
+            g4trace_write_inst(s, r);
+            break;
+          }
+          case Msg::START:
+            g4trace_write_start(s, get<reg_t>(p));
+            break;
+          case Msg::CLEAR:
+            g4trace_write_clear(s);
+            break;
+          case Msg::END:
+            g4trace_write_end(s, get<reg_t>(p));
+            break;
+          case Msg::COMMENT:
+            comment.resize(get<uint32_t>(p));
+            memcpy(comment.data(), p, comment.size());
+            p += comment.size();
+            g4trace_write_comment(s, comment);
+            break;
+          case Msg::FRAME: {
+            auto kind = get<G4TraceFrameKind>(p);
+            auto first_instruction = get<uint64_t>(p);
+            g4trace_write_frame(s, kind, first_instruction, get<reg_t>(p));
+            break;
+          }
+          case Msg::EXIT:
+            return;
+        }
+      }
+      free_blocks.release();
+    }
+  }
+};
+
+static void g4trace_put_accesses(G4TraceWriter *w, const commit_log_mem_t *accesses) {
+  w->put(uint32_t(accesses ? accesses->size() : 0));
+  if (accesses) {
+    for (const auto& a : *accesses) {
+      w->put(get<0>(a));
+      w->put(get<2>(a));
+    }
+  }
+}
+
+// The g4trace_emit_* functions run on the simulating thread: they either
+// write the record or pass it on to the writer thread.
+
+// Frames are started lazily, right before the next record, so that none of them is empty.
+static void g4trace_request_frame(G4TracePerProcState& s, G4TraceFrameKind kind) {
+  s.frame_pending = true;
+  s.pending_frame_kind = kind;
+}
+
+static void g4trace_begin_record(G4TracePerProcState& s) {
+  if (s.frame_pending) {
+    s.frame_pending = false;
+    s.frame_first_instruction = s.instructions_traced;
+    if (auto w = s.writer) {
+      w->put(G4TraceWriter::Msg::FRAME);
+      w->put(s.pending_frame_kind);
+      w->put(s.instructions_traced);
+      w->put(s.lastpc);
+      w->end_message();
+    } else {
+      g4trace_write_frame(s, s.pending_frame_kind, s.instructions_traced, s.lastpc);
+    }
+  }
+}
+
+static void g4trace_emit_start(G4TracePerProcState& s, reg_t pc) {
+  g4trace_begin_record(s);
+  if (auto w = s.writer) {
+    w->put(G4TraceWriter::Msg::START);
+    w->put(pc);
+    w->end_message();
+  } else {
+    g4trace_write_start(s, pc);
+  }
+}
+
+static void g4trace_emit_clear(G4TracePerProcState& s) {
+  g4trace_begin_record(s);
+  if (auto w = s.writer) {
+    w->put(G4TraceWriter::Msg::CLEAR);
+    w->end_message();
+  } else {
+    g4trace_write_clear(s);
+  }
+}
+
+static void g4trace_emit_end(G4TracePerProcState& s, reg_t pc) {
+  g4trace_begin_record(s);
+  if (auto w = s.writer) {
+    w->put(G4TraceWriter::Msg::END);
+    w->put(pc);
+    w->flush(); // the trace is flushed at the end of each ROI
+  } else {
+    g4trace_write_end(s, pc);
+  }
+}
+
+static void g4trace_emit_comment(G4TracePerProcState& s, const string& comment) {
+  g4trace_begin_record(s);
+  if (auto w = s.writer) {
+    w->put(G4TraceWriter::Msg::COMMENT);
+    w->put(uint32_t(comment.size()));
+    w->put_bytes(comment.data(), comment.size());
+    w->end_message();
+  } else {
+    g4trace_write_comment(s, comment);
+  }
+}
+
+static void g4trace_emit_inst(G4TracePerProcState& s, const G4TraceInstRecord& r) {
+  g4trace_begin_record(s);
+  if (auto w = s.writer) {
+    w->put(G4TraceWriter::Msg::INST);
+    w->put(r.type);
+    w->put(r.memory_access_type);
+    w->put(r.diffpc);
+    w->put(r.target_offset);
+    w->put(uint8_t(r.has_target | r.target_from_setpc << 1));
+    for (const G4TraceRegList *l : { &r.x, &r.y, &r.z }) {
+      w->put(uint8_t(l->size));
+      w->put_bytes(l->ids, l->size * sizeof(G4TraceRegId));
+    }
+    g4trace_put_accesses(w, r.loads);
+    g4trace_put_accesses(w, r.stores);
+    w->end_message();
+  } else {
+    g4trace_write_inst(s, r);
+  }
+}
+
 void g4trace_trace_inst(processor_t *p, reg_t pc, insn_t insn, G4TraceDecoder decoder) {
   if (!p->get_log_active()) return;
   if (p->get_state()->last_inst_priv && p->get_log_filter_privileged()) return;
@@ -425,17 +885,15 @@ void g4trace_trace_inst(processor_t *p, reg_t pc, insn_t insn, G4TraceDecoder de
   auto& stores = p->get_state()->log_mem_write;
 
   auto& g4ts = p->get_log_g4_trace_state();
-  auto out = g4ts.out;
   
   if (g4ts.instructions_traced >= p->get_log_g4trace_max_instructions()) {
-    *out << "END " << hex << g4ts.lastpc << dec << endl;
+    g4trace_emit_end(g4ts, g4ts.lastpc);
     // TODO maybe out->close();
     return; // don't print operands, don't update lastpc
   }
 
   if (p->get_log_g4_trace_config()->verbose) {
-    *out << "{ " << left << setw(32) << p->get_disassembler()->disassemble(insn) << " } ";
-    out->flush(); // TODO remove this, now here to ensure output is complete in case of assert.
+    g4trace_emit_comment(g4ts, p->get_disassembler()->disassemble(insn));
   }
 
   G4InstInfo g4i = decoder(p, pc, insn);
@@ -443,71 +901,32 @@ void g4trace_trace_inst(processor_t *p, reg_t pc, insn_t insn, G4TraceDecoder de
   bool ignore_csrs = true;
   bool ignore_vstatus = true;
 
-  int64_t diffpc = pc - g4ts.lastpc;
-  const char* prefix;
-  
-  if (g4i.type == G4InstType::GENERIC) {
-    prefix = "";
-  } else if (g4i.type == G4InstType::A) {
-    prefix = "A";
-  } else if (g4i.type == G4InstType::M) {
-    prefix = "M";
-  } else if (g4i.type == G4InstType::D) {
-    prefix = "D";
-  } else if (g4i.type == G4InstType::Q) {
-    prefix = "Q";
-  } else if (g4i.type == G4InstType::L) {
-    prefix = "L";
-    assert(g4i.memory_access_type != G4VectorMemAccessType::INVALID);
-  } else if (g4i.type == G4InstType::LA) {
-    prefix = "LA";
-    assert(g4i.memory_access_type != G4VectorMemAccessType::INVALID);
-  } else if (g4i.type == G4InstType::LR) {
-    prefix = "LA"; // TODO: should be SC, but gems4proc does not yet support it
-    assert(g4i.memory_access_type != G4VectorMemAccessType::INVALID);
-  } else if (g4i.type == G4InstType::S) {
-    prefix = "S";
-    assert(g4i.S_base_reg != g4trace_regid_invalid);
-    assert(g4i.S_data_reg != g4trace_regid_invalid);
+  if (g4i.type == G4InstType::L
+      || g4i.type == G4InstType::LA
+      || g4i.type == G4InstType::LR) {
     assert(g4i.memory_access_type != G4VectorMemAccessType::INVALID);
-  } else if (g4i.type == G4InstType::SA) {
-    prefix = "SA";
-    assert(g4i.S_base_reg != g4trace_regid_invalid);
-    assert(g4i.S_data_reg != g4trace_regid_invalid);
-    assert(g4i.memory_access_type != G4VectorMemAccessType::INVALID);
-  } else if (g4i.type == G4InstType::SC) {
-    prefix = "SA"; // TODO: should be SC, but gems4proc does not yet support it
+  } else if (g4i.type == G4InstType::S
+             || g4i.type == G4InstType::SA
+             || g4i.type == G4InstType::SC) {
     assert(g4i.S_base_reg != g4trace_regid_invalid);
     assert(g4i.S_data_reg != g4trace_regid_invalid);
     assert(g4i.memory_access_type != G4VectorMemAccessType::INVALID);
   } else if (g4i.type == G4InstType::RMW) {
-    prefix = "RMW";
     assert(g4i.S_base_reg != g4trace_regid_invalid);
     assert(g4i.S_data_reg != g4trace_regid_invalid);
     assert(g4i.memory_access_type != G4VectorMemAccessType::INVALID);
     assert(loads.size() == stores.size()); // TODO: check that this is necessarily true (maybe the stores don't always happen?);
-  } else if (g4i.type == G4InstType::B) {
-    prefix = "B";
-    assert(g4i.target_address != g4trace_invalid_target_address);
-  } else if (g4i.type == G4InstType::C) {
-    prefix = "C";
-    assert(g4i.target_address != g4trace_invalid_target_address);
-  } else if (g4i.type == G4InstType::J) {
-    prefix = "J";
-    assert(g4i.target_address != g4trace_invalid_target_address);
-  } else if (g4i.type == G4InstType::j) {
-    prefix = "j";
-    assert(g4i.target_address != g4trace_invalid_target_address);
-  } else if (g4i.type == G4InstType::r) {
-    prefix = "r";
-    assert(g4i.target_address != g4trace_invalid_target_address);
-  } else if (g4i.type == G4InstType::c) {
-    prefix = "c";
+  } else if (g4i.type == G4InstType::B
+             || g4i.type == G4InstType::C
+             || g4i.type == G4InstType::J
+             || g4i.type == G4InstType::j
+             || g4i.type == G4InstType::r
+             || g4i.type == G4InstType::c) {
     assert(g4i.target_address != g4trace_invalid_target_address);
   } else if (g4i.type == G4InstType::START_TRACING) {
     if (!p->get_log_g4trace_has_started()) {
       g4ts.lastpc = pc + 4; // Address of next instruction, which will be the first in the trace
-      *out << hex << g4ts.lastpc << dec << "\n";
+      g4trace_emit_start(g4ts, g4ts.lastpc);
       p->set_log_g4trace_has_started();
       return; // don't print operands
     } else {
@@ -516,18 +935,25 @@ void g4trace_trace_inst(processor_t *p, reg_t pc, insn_t insn, G4TraceDecoder de
       return;
     }
   } else if (g4i.type == G4InstType::CLEAR) {
-    *out << "CLEAR\n";
+    g4trace_request_frame(g4ts, G4TraceFrameKind::CLEAR);
+    g4trace_emit_clear(g4ts);
     return; // don't print operands, don't update lastpc
   } else if (g4i.type == G4InstType::END_ROI) {
-    *out << "END " << hex << g4ts.lastpc << dec << endl;
+    g4trace_emit_end(g4ts, g4ts.lastpc);
+    g4trace_request_frame(g4ts, G4TraceFrameKind::END_ROI);
     // TODO maybe out->close();
     return; // don't print operands, don't update lastpc
-  } else {
-    prefix = "UNKNOWN";
+  } else if (g4i.type != G4InstType::GENERIC
+             && g4i.type != G4InstType::A
+             && g4i.type != G4InstType::M
+             && g4i.type != G4InstType::D
+             && g4i.type != G4InstType::Q) {
     assert(g4i.type == G4InstType::UNKNOWN);
   }
 
-  *out << prefix << diffpc;
+  G4TraceInstRecord r;
+  r.type = g4i.type;
+  r.diffpc = pc - g4ts.lastpc;
 
   assert(p->get_log_g4_trace_config()->verbose || g4i.type != G4InstType::UNKNOWN);
   assert(loads.empty() || (g4i.type == G4InstType::L || g4i.type == G4InstType::LA || g4i.type == G4InstType::LR || g4i.type == G4InstType::RMW));
@@ -542,12 +968,13 @@ void g4trace_trace_inst(processor_t *p, reg_t pc, insn_t insn, G4TraceDecoder de
       /* || g4i.type == G4InstType::RMW*/) {
     assert(g4i.S_base_reg != g4trace_regid_invalid);
     assert(g4i.S_data_reg != g4trace_regid_invalid);
-    assert(count_if(read_regs.begin(), read_regs.end(), [&](auto x){ return g4trace_regid_from_commit_log_reg_id(x.first) == g4i.S_base_reg; }) == 1);
-    assert(count_if(read_regs.begin(), read_regs.end(), [&](auto x){ return g4trace_regid_from_commit_log_reg_id(x.first) == g4i.S_data_reg; }) == 1 || stores.empty()); // vector stores may write 0 elements (and hence read 0 data registers)
+    bool base_read = read_regs.count(g4trace_commit_log_reg_id(g4i.S_base_reg));
+    assert(base_read);
+    assert(read_regs.count(g4trace_commit_log_reg_id(g4i.S_data_reg)) || stores.empty()); // vector stores may write 0 elements (and hence read 0 data registers)
 
     // print the base register as x, the rest as y (must be data) TODO: this is wrong for masked stores
-    *out << "x" << g4i.S_base_reg.id;
-    if (count_if(read_regs.begin(), read_regs.end(), [&](auto x){ return g4trace_regid_from_commit_log_reg_id(x.first) != g4i.S_base_reg; }) == 0) {
+    r.x.push_back(g4i.S_base_reg);
+    if (read_regs.size() == size_t(base_read)) {
       // only the base_reg has been read, so the data register must be the same, or it has not been read (0 element vector store)
       assert(g4i.S_base_reg == g4i.S_data_reg || stores.empty()); // is this true in all cases?
       assert(read_regs.size() == 1);
@@ -557,7 +984,7 @@ void g4trace_trace_inst(processor_t *p, reg_t pc, insn_t insn, G4TraceDecoder de
         if (g4rid != g4i.S_base_reg
             && (!commit_log_reg_id_is_csr(item.first) || !ignore_csrs)
             && (!commit_log_reg_id_is_vstatus(item.first) || !ignore_vstatus)) {
-          *out << "y" << g4rid.id;
+          r.y.push_back(g4rid);
         }
       }
     }
@@ -566,7 +993,7 @@ void g4trace_trace_inst(processor_t *p, reg_t pc, insn_t insn, G4TraceDecoder de
       auto g4rid = g4trace_regid_from_commit_log_reg_id(item.first);
       if ((!commit_log_reg_id_is_csr(item.first) || !ignore_csrs)
         && (!commit_log_reg_id_is_vstatus(item.first) || !ignore_vstatus)) {
-        *out << "x" << g4rid.id;
+        r.x.push_back(g4rid);
       }
     }
   }
@@ -577,24 +1004,23 @@ void g4trace_trace_inst(processor_t *p, reg_t pc, insn_t insn, G4TraceDecoder de
     auto g4rid = g4trace_regid_from_commit_log_reg_id(item.first);
     if (((item.first & 0xf) != 4 || !ignore_csrs)
       && (item.first & 0xf) != 3) {
-      *out << "z" << g4rid.id;
+      r.z.push_back(g4rid);
     }
   }
 
-  if (!loads.empty()) {
-    g4trace_print_memory_access_addresses(loads, g4i, out);
-  }
-
-  if (!stores.empty() && g4i.type != G4InstType::RMW) { // don't print stores for RMWs, they sould be the same as loads
-    g4trace_print_memory_access_addresses(stores, g4i, out);
+  r.memory_access_type = g4i.memory_access_type;
+  r.loads = &loads;
+  if (g4i.type != G4InstType::RMW) { // don't print stores for RMWs, they sould be the same as loads
+    r.stores = &stores;
   }
 
   if (g4i.target_address != g4trace_invalid_target_address) {
     assert(g4i.type == G4InstType::B || g4i.type == G4InstType::C || g4i.type == G4InstType::c || g4i.type == G4InstType::J || g4i.type == G4InstType::j || g4i.type == G4InstType::r);
-    *out << "t" << (static_cast<int64_t>(g4i.target_address - pc));
+    r.has_target = true;
+    r.target_offset = static_cast<int64_t>(g4i.target_address - pc);
     if (g4i.type == G4InstType::B) {
       if (g4ts.setpc_done) {
-        *out << "*";
+        r.target_from_setpc = true;
         assert(g4i.target_address == g4ts.last_setpc);
       }
     } else {
@@ -603,10 +1029,92 @@ void g4trace_trace_inst(processor_t *p, reg_t pc, insn_t insn, G4TraceDecoder de
     }
   }
 
-  *out << '\n';
+  g4trace_emit_inst(g4ts, r);
   ++g4ts.instructions_traced;
+
+  auto frame_instructions = g4ts.global->frame_instructions;
+  if (frame_instructions > 0 && !g4ts.frame_pending
+      && g4ts.instructions_traced - g4ts.frame_first_instruction >= frame_instructions) {
+    g4trace_request_frame(g4ts, G4TraceFrameKind::SPLIT);
+  }
 }
 
+bool g4trace_convert_binary_to_text(istream& in, ostream& out) {
+  char magic[sizeof(g4trace_binary_magic)];
+  if (!in.read(magic, sizeof(magic)) || memcmp(magic, g4trace_binary_magic, sizeof(magic)) != 0) {
+    cerr << "Not a binary gems4proc trace." << endl;
+    return false;
+  }
+  int version = in.get();
+  if (version != g4trace_binary_version) {
+    cerr << "Unsupported binary gems4proc trace version " << version << "." << endl;
+    return false;
+  }
+
+  reg_t last_mem_addr = 0;
+  commit_log_mem_t loads, stores;
+  string comment;
+
+  for (int tag = in.get(); tag != EOF; tag = in.get()) {
+    uint64_t u;
+    if (tag == g4trace_binary_tag_start) {
+      if (!g4trace_get_varint(in, u))
+        return false;
+      out << hex << u << dec << "\n";
+    } else if (tag == g4trace_binary_tag_clear) {
+      out << "CLEAR\n";
+    } else if (tag == g4trace_binary_tag_end) {
+      if (!g4trace_get_varint(in, u))
+        return false;
+      out << "END " << hex << u << dec << "\n";
+    } else if (tag == g4trace_binary_tag_comment) {
+      if (!g4trace_get_varint(in, u))
+        return false;
+      comment.resize(u);
+      if (!in.read(comment.data(), u))
+        return false;
+      out << "{ " << left << setw(32) << comment << " } ";
+    } else {
+      G4TraceInstRecord r;
+      r.type = G4InstType(tag & ~(g4trace_binary_has_target | g4trace_binary_target_from_setpc));
+      r.has_target = tag & g4trace_binary_has_target;
+      r.target_from_setpc = tag & g4trace_binary_target_from_setpc;
+      int counts_byte;
+      if (!g4trace_get_svarint(in, r.diffpc) || (counts_byte = in.get()) == EOF)
+        return false;
+      uint64_t counts[4];
+      for (int i = 0; i < 4; i++) {
+        counts[i] = (counts_byte >> (2 * i)) & 3;
+        if (counts[i] == 3 && !g4trace_get_varint(in, counts[i]))
+          return false;
+      }
+      int i = 0;
+      for (G4TraceRegList *l : { &r.x, &r.y, &r.z }) {
+        if (counts[i] > G4TraceRegList::capacity)
+          return false;
+        for (uint64_t j = 0; j < counts[i]; j++) {
+          if (!g4trace_get_varint(in, u))
+            return false;
+          l->push_back({ int(u) });
+        }
+        i++;
+      }
+      if (counts[3] > 2)
+        return false;
+      commit_log_mem_t *groups[] = { &loads, &stores };
+      for (uint64_t j = 0; j < counts[3]; j++) {
+        if (!g4trace_get_mem_group(in, *groups[j], r.memory_access_type, last_mem_addr))
+          return false;
+      }
+      r.loads = counts[3] > 0 ? &loads : nullptr;
+      r.stores = counts[3] > 1 ? &stores : nullptr;
+      if (r.has_target && !g4trace_get_svarint(in, r.target_offset))
+        return false;
+      g4trace_print_text_inst(r, &out);
+    }
+  }
+  return true;
+}
 
 void g4trace_write_index(G4TraceConfig *global) {
   if (global && global->enable) {
@@ -617,6 +1125,18 @@ void g4trace_write_index(G4TraceConfig *global) {
       index_file << "TRACE_HAS_SEQUENCE_NUMBERS: 0\n";
       index_file << "TRACE_HAS_SC_vs_RELAXED_LOCK_TYPE: 0\n";
       index_file.close();
+
+      static const char *kind_names[] = { "START", "CLEAR", "END_ROI", "SPLIT" };
+      auto frames_filename = filesystem::path(global->dest) / "trace.frames";
+      ofstream frames_file(frames_filename, ios::out);
+      frames_file << "# trace kind first_instruction offset lastpc last_mem_addr\n";
+      for (size_t t = 0; t < global->frames.size(); t++) {
+        for (const auto& f : global->frames[t]) {
+          frames_file << t << " " << kind_names[int(f.kind)] << " " << f.first_instruction << " " << f.offset
+                      << " " << hex << f.lastpc << " " << f.last_mem_addr << dec << "\n";
+        }
+      }
+      frames_file.close();
     } else {
       cerr << "No gems4proc trace created. It seems no processor used the START_TRACING hint." << endl;
     }
@@ -645,32 +1165,103 @@ bool g4trace_parse_compression_config(const string& opts, string& method, int& p
   }
 }
 
+bool g4trace_parse_format(const string& opts, G4TraceFormat& format) {
+  if (opts == "text") {
+    format = G4TraceFormat::TEXT;
+    return true;
+  } else if (opts == "binary") {
+    format = G4TraceFormat::BINARY;
+    return true;
+  } else {
+    return false;
+  }
+}
+
+ostream *g4trace_open_compressed_ostream(const string& filename, const string& compression,
+                                        AsyncCompressorPool *pool) {
+  string comp;
+  int preset;
+  int r = g4trace_parse_compression_config(compression, comp, preset);
+  assert(r);
+  if (pool && comp != "none") {
+    auto method = comp == "zstd" ? AsyncOStreamBuf::Method::ZSTD : AsyncOStreamBuf::Method::LZMA;
+    return new AsyncOStream(*pool, filename, method, preset);
+  } else if (comp == "zstd") {
+    return new ZstdOStream(filename, preset);
+  } else if (comp == "lzma") {
+    return new LzmaOStream(filename, preset);
+  } else {
+    return new ofstream(filename, ios::out | ios::binary);
+  }
+}
+
+istream *g4trace_open_compressed_istream(const string& filename) {
+  static const unsigned char xz_magic[] = { 0xfd, '7', 'z', 'X', 'Z', 0x00 };
+  static const unsigned char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+  unsigned char head[sizeof(xz_magic)] = {};
+  {
+    ifstream f(filename, ios::in | ios::binary);
+    if (!f)
+      return nullptr;
+    f.read((char *) head, sizeof(head));
+  }
+  if (memcmp(head, xz_magic, sizeof(xz_magic)) == 0) {
+    return new LzmaIStream(filename);
+  } else if (memcmp(head, zstd_magic, sizeof(zstd_magic)) == 0) {
+    return new ZstdIStream(filename);
+  } else {
+    return new ifstream(filename, ios::in | ios::binary);
+  }
+}
+
 void g4trace_open_trace_file(G4TracePerProcState& s) {
   assert(s.global->enable);
   assert(s.out == nullptr);
+  lock_guard<mutex> guard(s.global->lock);
   if (!filesystem::exists(s.global->dest)) {
     filesystem::create_directory(s.global->dest);
   }
+  bool binary = s.global->format == G4TraceFormat::BINARY;
   stringstream name;
-  name << "trace-" << setw(4) << setfill('0') << s.global->num_traces << ".trc";
+  name << "trace-" << setw(4) << setfill('0') << s.global->num_traces << (binary ? ".trcb" : ".trc");
   filesystem::path p = filesystem::path(s.global->dest) / name.str();
-  string comp;
-  int preset;
-  int r = g4trace_parse_compression_config(s.global->compression, comp, preset);
-  assert(r);
-  if (comp == "none") {
-    s.out = new ofstream(p);
-  } else if (comp == "zstd") {
-    s.out = new ZstdOStream(p, preset);
-  } else if (comp == "lzma") {
-    s.out = new LzmaOStream(p, preset);
+  if (s.global->compress_threads > 0 && !s.global->compressor_pool) {
+    s.global->compressor_pool = make_shared<AsyncCompressorPool>(s.global->compress_threads);
+  }
+  s.out = g4trace_open_compressed_ostream(p, s.global->compression, s.global->compressor_pool.get());
+  if (binary) {
+    s.out->write(g4trace_binary_magic, sizeof(g4trace_binary_magic));
+    s.out->put(g4trace_binary_version);
   }
+  s.trace_id = s.global->num_traces;
+  s.global->frames.resize(s.trace_id + 1);
+  s.frames = &s.global->frames[s.trace_id];
+  s.frames->push_back({ G4TraceFrameKind::START, 0, 0, 0, 0 });
   ++s.global->num_traces;
+  if (s.global->writer_threads)
+    s.writer = new G4TraceWriter(s);
 }
 
 void g4trace_close_trace_file(G4TracePerProcState& s) {
+  if (s.writer) {
+    s.writer->finish();
+    delete s.writer;
+    s.writer = nullptr;
+    cerr << "g4trace: trace " << s.trace_id << ": the simulation waited " << s.writer_stalls
+         << " times for the writer thread" << endl;
+  }
   if (s.out) {
     s.out->flush();
+    if (auto a = dynamic_cast<AsyncOStream *>(s.out)) {
+      a->close();
+      auto offsets = a->frame_offsets().begin();
+      for (auto& f : *s.frames) {
+        if (f.offset == g4trace_unknown_frame_offset) {
+          assert(offsets != a->frame_offsets().end());
+          f.offset = *offsets++;
+        }
+      }
+    }
     delete s.out;
     s.out = nullptr;
   }
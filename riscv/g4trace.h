@@ -4,8 +4,41 @@
 #include "config.h"
 #include "memif.h"
 #include <cstdint>
+#include <deque>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <ostream>
+#include <istream>
+#include <vector>
+
+enum class G4TraceFormat {
+  TEXT,   // the .trc text format read by gems4proc
+  BINARY, // compact records, see g4trace_convert_binary_to_text
+};
+
+// Trace files are split in frames that can be decompressed independently
+// (separate xz streams or zstd frames). g4trace_write_index records where
+// each of them starts in trace.frames, so that readers can seek to any ROI.
+enum class G4TraceFrameKind {
+  START,   // first frame of the trace
+  CLEAR,   // starts with the CLEAR of a ROI
+  END_ROI, // follows the END of a ROI
+  SPLIT,   // started after --log-g4trace-frame-instructions instructions
+};
+
+struct G4TraceFrame {
+  G4TraceFrameKind kind;
+  uint64_t first_instruction; // number of instructions traced before the frame
+  uint64_t offset;            // byte offset of the frame in the (compressed) trace file
+  reg_t lastpc;               // pc that the first instruction of the frame is relative to
+  reg_t last_mem_addr;        // base of the first memory address delta (binary format)
+};
+
+const uint64_t g4trace_unknown_frame_offset = -1;
+
+class AsyncCompressorPool;
+class G4TraceWriter;
 
 struct G4TraceConfig {
   bool enable = false;
@@ -14,6 +47,13 @@ struct G4TraceConfig {
   int num_traces = 0; // number of harts that have started tracing
   uint64_t max_trace_instructions = std::numeric_limits<decltype(max_trace_instructions)>::max();
   std::string compression = "lzma-3";//"zstd-13";// "none";
+  G4TraceFormat format = G4TraceFormat::TEXT;
+  unsigned compress_threads = 0; // 0 compresses inline on the simulating thread
+  std::shared_ptr<AsyncCompressorPool> compressor_pool; // shared by all traces, created with the first one
+  uint64_t frame_instructions = 1000000; // start a new frame after this many instructions (0: only at ROI boundaries)
+  bool writer_threads = false; // format and write each trace on its own thread
+  std::deque<std::vector<G4TraceFrame>> frames; // per trace (a deque, so that G4TracePerProcState::frames stays valid)
+  std::mutex lock; // guards num_traces, compressor_pool and frames.size() when harts run on several threads
 };
 
 struct G4TracePerProcState {
@@ -24,6 +64,15 @@ struct G4TracePerProcState {
   bool setpc_done = false;
   reg_t last_setpc = 0;
   uint64_t instructions_traced = 0;
+  reg_t last_mem_addr = 0; // memory addresses are delta encoded in the binary format
+  std::vector<uint8_t> record_buf; // scratch buffer for binary records
+  int trace_id = -1;
+  std::vector<G4TraceFrame> *frames = nullptr; // global->frames[trace_id]
+  bool frame_pending = false; // a new frame starts with the next record
+  G4TraceFrameKind pending_frame_kind = G4TraceFrameKind::SPLIT;
+  uint64_t frame_first_instruction = 0; // first_instruction of the current frame
+  G4TraceWriter *writer = nullptr; // writer thread (writer_threads), owns out, last_mem_addr, record_buf and frames
+  uint64_t writer_stalls = 0; // blocks that had to wait for the writer thread to catch up
 };
 
 struct G4TraceRegId {
@@ -77,5 +126,10 @@ void g4trace_open_trace_file(G4TracePerProcState& s);
 void g4trace_close_trace_file(G4TracePerProcState& s);
 void g4trace_write_index(G4TraceConfig *global);
 bool g4trace_parse_compression_config(const std::string& opts, std::string& method, int& preset);
+bool g4trace_parse_format(const std::string& opts, G4TraceFormat& format);
+std::ostream *g4trace_open_compressed_ostream(const std::string& filename, const std::string& compression,
+                                             AsyncCompressorPool *pool = nullptr);
+std::istream *g4trace_open_compressed_istream(const std::string& filename);
+bool g4trace_convert_binary_to_text(std::istream& in, std::ostream& out);
 
 #endif
@@ -0,0 +1,667 @@
+// gems4proc decoders of the instructions traced by g4trace, by spike instruction name.
+//
+// G4TRACE_INSN(name, decoder) selects g4trace_decode_<decoder> (g4trace.cc) for
+// the instruction <name> of riscv/insns. Instructions that are not listed are
+// traced as UNKNOWN. check-g4trace-decoders.t.cc verifies that every name is a
+// spike instruction and that no load, store, atomic or control transfer
+// instruction is missing.
+
+// Tracing hints (srai zero, zero, N), see g4tracer-interface
+G4TRACE_INSN(srai, srai)
+
+// Integer ALU
+G4TRACE_INSN(add, generic)
+G4TRACE_INSN(addi, generic)
+G4TRACE_INSN(addiw, generic)
+G4TRACE_INSN(addw, generic)
+G4TRACE_INSN(add_uw, generic)
+G4TRACE_INSN(and, generic)
+G4TRACE_INSN(andn, generic)
+G4TRACE_INSN(andi, generic)
+G4TRACE_INSN(auipc, generic)
+G4TRACE_INSN(lui, generic)
+G4TRACE_INSN(or, generic)
+G4TRACE_INSN(ori, generic)
+G4TRACE_INSN(sll, generic)
+G4TRACE_INSN(slli, generic)
+G4TRACE_INSN(slliw, generic)
+G4TRACE_INSN(sllw, generic)
+G4TRACE_INSN(slt, generic)
+G4TRACE_INSN(slti, generic)
+G4TRACE_INSN(sltiu, generic)
+G4TRACE_INSN(sltu, generic)
+G4TRACE_INSN(sra, generic)
+G4TRACE_INSN(sraiw, generic)
+G4TRACE_INSN(sraw, generic)
+G4TRACE_INSN(srl, generic)
+G4TRACE_INSN(srli, generic)
+G4TRACE_INSN(srliw, generic)
+G4TRACE_INSN(srlw, generic)
+G4TRACE_INSN(sub, generic)
+G4TRACE_INSN(subw, generic)
+G4TRACE_INSN(xor, generic)
+G4TRACE_INSN(xori, generic)
+G4TRACE_INSN(c_add, generic)
+G4TRACE_INSN(c_addi, generic)
+G4TRACE_INSN(c_addi4spn, generic)
+G4TRACE_INSN(c_addw, generic)
+G4TRACE_INSN(c_and, generic)
+G4TRACE_INSN(c_andi, generic)
+G4TRACE_INSN(c_li, generic)
+G4TRACE_INSN(c_lui, generic)
+G4TRACE_INSN(c_mv, generic)
+G4TRACE_INSN(c_or, generic)
+G4TRACE_INSN(c_slli, generic)
+G4TRACE_INSN(c_srai, generic)
+G4TRACE_INSN(c_srli, generic)
+G4TRACE_INSN(c_sub, generic)
+G4TRACE_INSN(c_subw, generic)
+G4TRACE_INSN(c_xor, generic)
+
+// Branches
+G4TRACE_INSN(beq, branch)
+G4TRACE_INSN(bge, branch)
+G4TRACE_INSN(bgeu, branch)
+G4TRACE_INSN(blt, branch)
+G4TRACE_INSN(bltu, branch)
+G4TRACE_INSN(bne, branch)
+G4TRACE_INSN(c_beqz, c_branch)
+G4TRACE_INSN(c_bnez, c_branch)
+
+// Jumps
+G4TRACE_INSN(c_j, c_j)
+G4TRACE_INSN(c_jr, c_jr)
+
+// c.jal decodes as c.addiw in RV64
+G4TRACE_INSN(c_jal, c_addiw)
+G4TRACE_INSN(jal, jal)
+G4TRACE_INSN(jalr, jalr)
+G4TRACE_INSN(c_jalr, c_jalr)
+
+// Loads
+G4TRACE_INSN(lb, load)
+G4TRACE_INSN(lbu, load)
+G4TRACE_INSN(ld, load)
+G4TRACE_INSN(lh, load)
+G4TRACE_INSN(lhu, load)
+G4TRACE_INSN(lw, load)
+G4TRACE_INSN(lwu, load)
+G4TRACE_INSN(fld, load)
+G4TRACE_INSN(flw, load)
+G4TRACE_INSN(flq, load)
+G4TRACE_INSN(vle8_v, load)
+G4TRACE_INSN(vle16_v, load)
+G4TRACE_INSN(vle32_v, load)
+G4TRACE_INSN(vle64_v, load)
+G4TRACE_INSN(vle8ff_v, load)
+G4TRACE_INSN(vle16ff_v, load)
+G4TRACE_INSN(vle32ff_v, load)
+G4TRACE_INSN(vle64ff_v, load)
+G4TRACE_INSN(vluxei8_v, load)
+G4TRACE_INSN(vluxei16_v, load)
+G4TRACE_INSN(vluxei32_v, load)
+G4TRACE_INSN(vluxei64_v, load)
+G4TRACE_INSN(vlse8_v, load)
+G4TRACE_INSN(vlse16_v, load)
+G4TRACE_INSN(vlse32_v, load)
+G4TRACE_INSN(vlse64_v, load)
+G4TRACE_INSN(vlm_v, load)
+G4TRACE_INSN(vl1re16_v, load)
+G4TRACE_INSN(vl1re32_v, load)
+G4TRACE_INSN(vl1re64_v, load)
+G4TRACE_INSN(vl1re8_v, load)
+G4TRACE_INSN(vl2re16_v, load)
+G4TRACE_INSN(vl2re32_v, load)
+G4TRACE_INSN(vl2re64_v, load)
+G4TRACE_INSN(vl2re8_v, load)
+G4TRACE_INSN(vl4re16_v, load)
+G4TRACE_INSN(vl4re32_v, load)
+G4TRACE_INSN(vl4re64_v, load)
+G4TRACE_INSN(vl4re8_v, load)
+G4TRACE_INSN(vl8re16_v, load)
+G4TRACE_INSN(vl8re32_v, load)
+G4TRACE_INSN(vl8re64_v, load)
+G4TRACE_INSN(vl8re8_v, load)
+G4TRACE_INSN(vloxei8_v, load)
+G4TRACE_INSN(vloxei16_v, load)
+G4TRACE_INSN(vloxei32_v, load)
+G4TRACE_INSN(vloxei64_v, load)
+G4TRACE_INSN(flh, load)
+G4TRACE_INSN(c_fld, c_load)
+G4TRACE_INSN(c_ld, c_load)
+G4TRACE_INSN(c_lw, c_load)
+G4TRACE_INSN(c_lbu, c_load)
+G4TRACE_INSN(c_lhu, c_load)
+G4TRACE_INSN(c_lh, c_load)
+G4TRACE_INSN(c_ldsp, c_load)
+G4TRACE_INSN(c_lwsp, c_load)
+G4TRACE_INSN(c_fldsp, c_load)
+G4TRACE_INSN(c_flw, c_load)
+G4TRACE_INSN(c_flwsp, c_load)
+
+// Stores
+G4TRACE_INSN(c_sd, c_store)
+G4TRACE_INSN(c_sw, c_store)
+G4TRACE_INSN(c_fsd, c_store)
+G4TRACE_INSN(c_fsw, c_fp_store)
+G4TRACE_INSN(c_sb, c_int_store)
+G4TRACE_INSN(c_sh, c_int_store)
+G4TRACE_INSN(c_sdsp, c_store_sp)
+G4TRACE_INSN(c_swsp, c_store_sp)
+G4TRACE_INSN(c_fsdsp, c_store_sp)
+G4TRACE_INSN(c_fswsp, c_fp_store_sp)
+G4TRACE_INSN(sb, store)
+G4TRACE_INSN(sd, store)
+G4TRACE_INSN(sh, store)
+G4TRACE_INSN(sw, store)
+G4TRACE_INSN(vse8_v, store)
+G4TRACE_INSN(vse16_v, store)
+G4TRACE_INSN(vse32_v, store)
+G4TRACE_INSN(vse64_v, store)
+G4TRACE_INSN(vsuxei8_v, store)
+G4TRACE_INSN(vsuxei16_v, store)
+G4TRACE_INSN(vsuxei32_v, store)
+G4TRACE_INSN(vsuxei64_v, store)
+G4TRACE_INSN(vsm_v, store)
+G4TRACE_INSN(vs1r_v, store)
+G4TRACE_INSN(vs2r_v, store)
+G4TRACE_INSN(vs4r_v, store)
+G4TRACE_INSN(vs8r_v, store)
+G4TRACE_INSN(vsse8_v, store)
+G4TRACE_INSN(vsse16_v, store)
+G4TRACE_INSN(vsse32_v, store)
+G4TRACE_INSN(vsse64_v, store)
+G4TRACE_INSN(vsoxei8_v, store)
+G4TRACE_INSN(vsoxei16_v, store)
+G4TRACE_INSN(vsoxei32_v, store)
+G4TRACE_INSN(vsoxei64_v, store)
+G4TRACE_INSN(fsd, fp_store)
+G4TRACE_INSN(fsh, fp_store)
+G4TRACE_INSN(fsq, fp_store)
+G4TRACE_INSN(fsw, fp_store)
+
+// Atomics
+G4TRACE_INSN(lr_d, lr)
+G4TRACE_INSN(lr_w, lr)
+G4TRACE_INSN(sc_d, sc)
+G4TRACE_INSN(sc_w, sc)
+G4TRACE_INSN(lb_aq, load_acquire)
+G4TRACE_INSN(lh_aq, load_acquire)
+G4TRACE_INSN(lw_aq, load_acquire)
+G4TRACE_INSN(ld_aq, load_acquire)
+G4TRACE_INSN(sb_rl, store_release)
+G4TRACE_INSN(sh_rl, store_release)
+G4TRACE_INSN(sw_rl, store_release)
+G4TRACE_INSN(sd_rl, store_release)
+G4TRACE_INSN(amoadd_d, amo)
+G4TRACE_INSN(amoadd_w, amo)
+G4TRACE_INSN(amoand_d, amo)
+G4TRACE_INSN(amoand_w, amo)
+G4TRACE_INSN(amomax_d, amo)
+G4TRACE_INSN(amomaxu_d, amo)
+G4TRACE_INSN(amomaxu_w, amo)
+G4TRACE_INSN(amomax_w, amo)
+G4TRACE_INSN(amomin_d, amo)
+G4TRACE_INSN(amominu_d, amo)
+G4TRACE_INSN(amominu_w, amo)
+G4TRACE_INSN(amomin_w, amo)
+G4TRACE_INSN(amoor_d, amo)
+G4TRACE_INSN(amoor_w, amo)
+G4TRACE_INSN(amoswap_d, amo)
+G4TRACE_INSN(amoswap_w, amo)
+G4TRACE_INSN(amoxor_d, amo)
+G4TRACE_INSN(amoxor_w, amo)
+G4TRACE_INSN(amoadd_h, amo)
+G4TRACE_INSN(amoand_b, amo)
+G4TRACE_INSN(amoand_h, amo)
+G4TRACE_INSN(amocas_b, amo)
+G4TRACE_INSN(amocas_d, amo)
+G4TRACE_INSN(amocas_h, amo)
+G4TRACE_INSN(amocas_q, amo)
+G4TRACE_INSN(amocas_w, amo)
+G4TRACE_INSN(amomax_b, amo)
+G4TRACE_INSN(amomax_h, amo)
+G4TRACE_INSN(amomaxu_b, amo)
+G4TRACE_INSN(amomaxu_h, amo)
+G4TRACE_INSN(amomin_b, amo)
+G4TRACE_INSN(amomin_h, amo)
+G4TRACE_INSN(amominu_b, amo)
+G4TRACE_INSN(amominu_h, amo)
+G4TRACE_INSN(amoor_b, amo)
+G4TRACE_INSN(amoor_h, amo)
+G4TRACE_INSN(amoswap_b, amo)
+G4TRACE_INSN(amoswap_h, amo)
+G4TRACE_INSN(amoxor_b, amo)
+G4TRACE_INSN(amoxor_h, amo)
+G4TRACE_INSN(amoadd_b, amo)
+G4TRACE_INSN(ssamoswap_w, amo)
+G4TRACE_INSN(ssamoswap_d, amo)
+
+// Fences
+G4TRACE_INSN(fence, generic)
+G4TRACE_INSN(fence_i, generic)
+
+// Floating point fused multiply-add
+G4TRACE_INSN(fmadd_d, fp_mul)
+G4TRACE_INSN(fmadd_h, fp_mul)
+G4TRACE_INSN(fmadd_q, fp_mul)
+G4TRACE_INSN(fmadd_s, fp_mul)
+G4TRACE_INSN(fmsub_d, fp_mul)
+G4TRACE_INSN(fmsub_h, fp_mul)
+G4TRACE_INSN(fmsub_q, fp_mul)
+G4TRACE_INSN(fmsub_s, fp_mul)
+G4TRACE_INSN(fnmadd_d, fp_mul)
+G4TRACE_INSN(fnmadd_h, fp_mul)
+G4TRACE_INSN(fnmadd_q, fp_mul)
+G4TRACE_INSN(fnmadd_s, fp_mul)
+G4TRACE_INSN(fnmsub_d, fp_mul)
+G4TRACE_INSN(fnmsub_h, fp_mul)
+G4TRACE_INSN(fnmsub_q, fp_mul)
+G4TRACE_INSN(fnmsub_s, fp_mul)
+
+// Multiplications
+G4TRACE_INSN(fmul_d, fp_mul)
+G4TRACE_INSN(fmul_h, fp_mul)
+G4TRACE_INSN(fmul_q, fp_mul)
+G4TRACE_INSN(fmul_s, fp_mul)
+G4TRACE_INSN(vfmul_vf, fp_mul)
+G4TRACE_INSN(vfmul_vv, fp_mul)
+G4TRACE_INSN(vfwmul_vf, fp_mul)
+G4TRACE_INSN(vfwmul_vv, fp_mul)
+
+// Integer and carry-less multiplications (not modeled as M)
+G4TRACE_INSN(clmulh, generic)
+G4TRACE_INSN(clmul, generic)
+G4TRACE_INSN(clmulr, generic)
+G4TRACE_INSN(c_mul, generic)
+G4TRACE_INSN(mulh, generic)
+G4TRACE_INSN(mulhsu, generic)
+G4TRACE_INSN(mulhu, generic)
+G4TRACE_INSN(mul, generic)
+G4TRACE_INSN(mulw, generic)
+G4TRACE_INSN(vclmulh_vv, generic)
+G4TRACE_INSN(vclmulh_vx, generic)
+G4TRACE_INSN(vclmul_vv, generic)
+G4TRACE_INSN(vclmul_vx, generic)
+G4TRACE_INSN(vmulhsu_vv, generic)
+G4TRACE_INSN(vmulhsu_vx, generic)
+G4TRACE_INSN(vmulhu_vv, generic)
+G4TRACE_INSN(vmulhu_vx, generic)
+G4TRACE_INSN(vmulh_vv, generic)
+G4TRACE_INSN(vmulh_vx, generic)
+G4TRACE_INSN(vmul_vv, generic)
+G4TRACE_INSN(vmul_vx, generic)
+G4TRACE_INSN(vsmul_vv, generic)
+G4TRACE_INSN(vsmul_vx, generic)
+G4TRACE_INSN(vwmulsu_vv, generic)
+G4TRACE_INSN(vwmulsu_vx, generic)
+G4TRACE_INSN(vwmulu_vv, generic)
+G4TRACE_INSN(vwmulu_vx, generic)
+G4TRACE_INSN(vwmul_vv, generic)
+G4TRACE_INSN(vwmul_vx, generic)
+
+// Floating point divisions
+G4TRACE_INSN(fdiv_s, fp_div)
+G4TRACE_INSN(fdiv_d, fp_div)
+G4TRACE_INSN(fdiv_q, fp_div)
+G4TRACE_INSN(fdiv_h, fp_div)
+G4TRACE_INSN(vfdiv_vf, fp_div)
+G4TRACE_INSN(vfdiv_vv, fp_div)
+G4TRACE_INSN(vfrdiv_vf, fp_div)
+
+// Integer divisions (not modeled as D)
+G4TRACE_INSN(div, generic)
+G4TRACE_INSN(divu, generic)
+G4TRACE_INSN(divuw, generic)
+G4TRACE_INSN(divw, generic)
+G4TRACE_INSN(rem, generic)
+G4TRACE_INSN(remu, generic)
+G4TRACE_INSN(remuw, generic)
+G4TRACE_INSN(remw, generic)
+G4TRACE_INSN(vdiv_vv, generic)
+G4TRACE_INSN(vdiv_vx, generic)
+G4TRACE_INSN(vdivu_vv, generic)
+G4TRACE_INSN(vdivu_vx, generic)
+G4TRACE_INSN(vrem_vv, generic)
+G4TRACE_INSN(vrem_vx, generic)
+G4TRACE_INSN(vremu_vv, generic)
+G4TRACE_INSN(vremu_vx, generic)
+
+// Floating point additions and comparisons
+G4TRACE_INSN(fadd_d, fp_add)
+G4TRACE_INSN(fadd_h, fp_add)
+G4TRACE_INSN(fadd_q, fp_add)
+G4TRACE_INSN(fadd_s, fp_add)
+G4TRACE_INSN(vfadd_vf, fp_add)
+G4TRACE_INSN(vfadd_vv, fp_add)
+G4TRACE_INSN(vfredosum_vs, fp_add)
+G4TRACE_INSN(vfredusum_vs, fp_add)
+G4TRACE_INSN(fsub_s, fp_add)
+G4TRACE_INSN(fsub_d, fp_add)
+G4TRACE_INSN(fsub_q, fp_add)
+G4TRACE_INSN(fsub_h, fp_add)
+G4TRACE_INSN(vfsub_vf, fp_add)
+G4TRACE_INSN(vfsub_vv, fp_add)
+G4TRACE_INSN(feq_s, fp_add)
+G4TRACE_INSN(feq_d, fp_add)
+G4TRACE_INSN(feq_q, fp_add)
+G4TRACE_INSN(feq_h, fp_add)
+G4TRACE_INSN(vmfeq_vf, fp_add)
+G4TRACE_INSN(vmfeq_vv, fp_add)
+
+// Square roots
+G4TRACE_INSN(fsqrt_s, fp_sqrt)
+G4TRACE_INSN(fsqrt_d, fp_sqrt)
+G4TRACE_INSN(vfrsqrt7_v, fp_sqrt)
+G4TRACE_INSN(vfsqrt_v, fp_sqrt)
+G4TRACE_INSN(fsqrt_q, fp_sqrt)
+G4TRACE_INSN(fsqrt_h, fp_sqrt)
+
+// Floating point moves, conversions, comparisons and sign injections
+G4TRACE_INSN(fmv_w_x, generic)
+G4TRACE_INSN(fmv_x_w, generic)
+G4TRACE_INSN(fmv_d_x, generic)
+G4TRACE_INSN(fmv_x_d, generic)
+G4TRACE_INSN(fmvh_x_d, generic)
+G4TRACE_INSN(fmvp_d_x, generic)
+G4TRACE_INSN(fmvh_x_q, generic)
+G4TRACE_INSN(fmvp_q_x, generic)
+G4TRACE_INSN(fmv_h_x, generic)
+G4TRACE_INSN(fmv_x_h, generic)
+G4TRACE_INSN(fcvt_l_h, generic)
+G4TRACE_INSN(fcvt_lu_h, generic)
+G4TRACE_INSN(fcvt_d_h, generic)
+G4TRACE_INSN(fcvt_h_d, generic)
+G4TRACE_INSN(fcvt_h_l, generic)
+G4TRACE_INSN(fcvt_h_lu, generic)
+G4TRACE_INSN(fcvt_h_q, generic)
+G4TRACE_INSN(fcvt_h_s, generic)
+G4TRACE_INSN(fcvt_h_w, generic)
+G4TRACE_INSN(fcvt_h_wu, generic)
+G4TRACE_INSN(fcvt_q_h, generic)
+G4TRACE_INSN(fcvt_s_h, generic)
+G4TRACE_INSN(fcvt_w_h, generic)
+G4TRACE_INSN(fcvt_wu_h, generic)
+G4TRACE_INSN(fcvt_l_s, generic)
+G4TRACE_INSN(fcvt_lu_s, generic)
+G4TRACE_INSN(fcvt_s_l, generic)
+G4TRACE_INSN(fcvt_s_lu, generic)
+G4TRACE_INSN(fcvt_s_w, generic)
+G4TRACE_INSN(fcvt_s_wu, generic)
+G4TRACE_INSN(fcvt_w_s, generic)
+G4TRACE_INSN(fcvt_wu_s, generic)
+G4TRACE_INSN(fcvt_d_l, generic)
+G4TRACE_INSN(fcvt_d_lu, generic)
+G4TRACE_INSN(fcvt_d_q, generic)
+G4TRACE_INSN(fcvt_d_s, generic)
+G4TRACE_INSN(fcvt_d_w, generic)
+G4TRACE_INSN(fcvt_d_wu, generic)
+G4TRACE_INSN(fcvt_l_d, generic)
+G4TRACE_INSN(fcvt_lu_d, generic)
+G4TRACE_INSN(fcvt_s_d, generic)
+G4TRACE_INSN(fcvt_w_d, generic)
+G4TRACE_INSN(fcvt_wu_d, generic)
+G4TRACE_INSN(fle_s, generic)
+G4TRACE_INSN(flt_s, generic)
+G4TRACE_INSN(fle_d, generic)
+G4TRACE_INSN(flt_d, generic)
+G4TRACE_INSN(fleq_d, generic)
+G4TRACE_INSN(fltq_d, generic)
+G4TRACE_INSN(fleq_s, generic)
+G4TRACE_INSN(fltq_s, generic)
+G4TRACE_INSN(fle_q, generic)
+G4TRACE_INSN(flt_q, generic)
+G4TRACE_INSN(fleq_q, generic)
+G4TRACE_INSN(fltq_q, generic)
+G4TRACE_INSN(fle_h, generic)
+G4TRACE_INSN(flt_h, generic)
+G4TRACE_INSN(fleq_h, generic)
+G4TRACE_INSN(fltq_h, generic)
+G4TRACE_INSN(fsgnj_s, generic)
+G4TRACE_INSN(fsgnjn_s, generic)
+G4TRACE_INSN(fsgnjx_s, generic)
+G4TRACE_INSN(fsgnj_d, generic)
+G4TRACE_INSN(fsgnjn_d, generic)
+G4TRACE_INSN(fsgnjx_d, generic)
+G4TRACE_INSN(fsgnj_q, generic)
+G4TRACE_INSN(fsgnjn_q, generic)
+G4TRACE_INSN(fsgnjx_q, generic)
+G4TRACE_INSN(fsgnj_h, generic)
+G4TRACE_INSN(fsgnjn_h, generic)
+G4TRACE_INSN(fsgnjx_h, generic)
+
+// Vector configuration
+G4TRACE_INSN(vsetivli, generic)
+G4TRACE_INSN(vsetvli, generic)
+G4TRACE_INSN(vsetvl, generic)
+
+// Vector integer, permutation, mask and conversion instructions
+G4TRACE_INSN(vfmv_f_s, generic)
+G4TRACE_INSN(vfmv_s_f, generic)
+G4TRACE_INSN(vfmv_v_f, generic)
+G4TRACE_INSN(vfncvt_f_f_w, generic)
+G4TRACE_INSN(vfncvt_f_x_w, generic)
+G4TRACE_INSN(vfncvt_f_xu_w, generic)
+G4TRACE_INSN(vfncvt_rod_f_f_w, generic)
+G4TRACE_INSN(vfncvt_rtz_x_f_w, generic)
+G4TRACE_INSN(vfncvt_rtz_xu_f_w, generic)
+G4TRACE_INSN(vfncvt_x_f_w, generic)
+G4TRACE_INSN(vfncvt_xu_f_w, generic)
+G4TRACE_INSN(vfcvt_f_x_v, generic)
+G4TRACE_INSN(vfcvt_f_xu_v, generic)
+G4TRACE_INSN(vfcvt_rtz_x_f_v, generic)
+G4TRACE_INSN(vfcvt_rtz_xu_f_v, generic)
+G4TRACE_INSN(vfcvt_x_f_v, generic)
+G4TRACE_INSN(vfcvt_xu_f_v, generic)
+G4TRACE_INSN(vfwcvt_f_f_v, generic)
+G4TRACE_INSN(vfwcvt_f_x_v, generic)
+G4TRACE_INSN(vfwcvt_f_xu_v, generic)
+G4TRACE_INSN(vfwcvt_rtz_x_f_v, generic)
+G4TRACE_INSN(vfwcvt_rtz_xu_f_v, generic)
+G4TRACE_INSN(vfwcvt_x_f_v, generic)
+G4TRACE_INSN(vfwcvt_xu_f_v, generic)
+G4TRACE_INSN(vmv1r_v, generic)
+G4TRACE_INSN(vmv2r_v, generic)
+G4TRACE_INSN(vmv4r_v, generic)
+G4TRACE_INSN(vmv8r_v, generic)
+G4TRACE_INSN(vmv_s_x, generic)
+G4TRACE_INSN(vmv_v_i, generic)
+G4TRACE_INSN(vmv_v_v, generic)
+G4TRACE_INSN(vmv_v_x, generic)
+G4TRACE_INSN(vmv_x_s, generic)
+G4TRACE_INSN(vid_v, generic)
+G4TRACE_INSN(viota_m, generic)
+G4TRACE_INSN(vor_vi, generic)
+G4TRACE_INSN(vor_vv, generic)
+G4TRACE_INSN(vor_vx, generic)
+G4TRACE_INSN(vandn_vv, generic)
+G4TRACE_INSN(vandn_vx, generic)
+G4TRACE_INSN(vand_vi, generic)
+G4TRACE_INSN(vand_vv, generic)
+G4TRACE_INSN(vand_vx, generic)
+G4TRACE_INSN(vxor_vi, generic)
+G4TRACE_INSN(vxor_vv, generic)
+G4TRACE_INSN(vxor_vx, generic)
+G4TRACE_INSN(vredand_vs, generic)
+G4TRACE_INSN(vredmax_vs, generic)
+G4TRACE_INSN(vredmaxu_vs, generic)
+G4TRACE_INSN(vredmin_vs, generic)
+G4TRACE_INSN(vredminu_vs, generic)
+G4TRACE_INSN(vredor_vs, generic)
+G4TRACE_INSN(vredsum_vs, generic)
+G4TRACE_INSN(vredxor_vs, generic)
+G4TRACE_INSN(vadd_vi, generic)
+G4TRACE_INSN(vadd_vv, generic)
+G4TRACE_INSN(vadd_vx, generic)
+G4TRACE_INSN(vsub_vv, generic)
+G4TRACE_INSN(vsub_vx, generic)
+G4TRACE_INSN(vrsub_vi, generic)
+G4TRACE_INSN(vrsub_vx, generic)
+G4TRACE_INSN(vwadd_vv, generic)
+G4TRACE_INSN(vwadd_vx, generic)
+G4TRACE_INSN(vwadd_wv, generic)
+G4TRACE_INSN(vwadd_wx, generic)
+G4TRACE_INSN(vwaddu_vv, generic)
+G4TRACE_INSN(vwaddu_vx, generic)
+G4TRACE_INSN(vwaddu_wv, generic)
+G4TRACE_INSN(vwaddu_wx, generic)
+G4TRACE_INSN(vwmacc_vv, generic)
+G4TRACE_INSN(vwmacc_vx, generic)
+G4TRACE_INSN(vwmaccsu_vv, generic)
+G4TRACE_INSN(vwmaccsu_vx, generic)
+G4TRACE_INSN(vwmaccu_vv, generic)
+G4TRACE_INSN(vwmaccu_vx, generic)
+G4TRACE_INSN(vwmaccus_vx, generic)
+G4TRACE_INSN(vasub_vv, generic)
+G4TRACE_INSN(vasubu_vv, generic)
+G4TRACE_INSN(vasub_vx, generic)
+G4TRACE_INSN(vasubu_vx, generic)
+G4TRACE_INSN(vsll_vi, generic)
+G4TRACE_INSN(vsll_vv, generic)
+G4TRACE_INSN(vsll_vx, generic)
+G4TRACE_INSN(vsra_vi, generic)
+G4TRACE_INSN(vsra_vv, generic)
+G4TRACE_INSN(vsra_vx, generic)
+G4TRACE_INSN(vsrl_vi, generic)
+G4TRACE_INSN(vsrl_vv, generic)
+G4TRACE_INSN(vsrl_vx, generic)
+G4TRACE_INSN(vssra_vi, generic)
+G4TRACE_INSN(vssra_vv, generic)
+G4TRACE_INSN(vssra_vx, generic)
+G4TRACE_INSN(vssrl_vi, generic)
+G4TRACE_INSN(vssrl_vv, generic)
+G4TRACE_INSN(vssrl_vx, generic)
+G4TRACE_INSN(vssub_vv, generic)
+G4TRACE_INSN(vssub_vx, generic)
+G4TRACE_INSN(vssubu_vv, generic)
+G4TRACE_INSN(vssubu_vx, generic)
+G4TRACE_INSN(vsext_vf2, generic)
+G4TRACE_INSN(vsext_vf4, generic)
+G4TRACE_INSN(vsext_vf8, generic)
+G4TRACE_INSN(vslide1down_vx, generic)
+G4TRACE_INSN(vslide1up_vx, generic)
+G4TRACE_INSN(vslidedown_vi, generic)
+G4TRACE_INSN(vslidedown_vx, generic)
+G4TRACE_INSN(vslideup_vi, generic)
+G4TRACE_INSN(vslideup_vx, generic)
+G4TRACE_INSN(vsadd_vi, generic)
+G4TRACE_INSN(vsadd_vv, generic)
+G4TRACE_INSN(vsadd_vx, generic)
+G4TRACE_INSN(vsaddu_vi, generic)
+G4TRACE_INSN(vsaddu_vv, generic)
+G4TRACE_INSN(vsaddu_vx, generic)
+G4TRACE_INSN(vsbc_vvm, generic)
+G4TRACE_INSN(vsbc_vxm, generic)
+G4TRACE_INSN(vmacc_vv, generic)
+G4TRACE_INSN(vmacc_vx, generic)
+G4TRACE_INSN(vmadc_vv, generic)
+G4TRACE_INSN(vmadc_vx, generic)
+G4TRACE_INSN(vmadc_vi, generic)
+G4TRACE_INSN(vmadc_vim, generic)
+G4TRACE_INSN(vmadc_vvm, generic)
+G4TRACE_INSN(vmadc_vxm, generic)
+G4TRACE_INSN(vmadd_vv, generic)
+G4TRACE_INSN(vmadd_vx, generic)
+G4TRACE_INSN(vmand_mm, generic)
+G4TRACE_INSN(vmandn_mm, generic)
+G4TRACE_INSN(vmax_vv, generic)
+G4TRACE_INSN(vmax_vx, generic)
+G4TRACE_INSN(vmaxu_vv, generic)
+G4TRACE_INSN(vmaxu_vx, generic)
+G4TRACE_INSN(vmin_vv, generic)
+G4TRACE_INSN(vmin_vx, generic)
+G4TRACE_INSN(vminu_vv, generic)
+G4TRACE_INSN(vminu_vx, generic)
+G4TRACE_INSN(vmnand_mm, generic)
+G4TRACE_INSN(vmnor_mm, generic)
+G4TRACE_INSN(vmor_mm, generic)
+G4TRACE_INSN(vmorn_mm, generic)
+G4TRACE_INSN(vmsbc_vv, generic)
+G4TRACE_INSN(vmsbc_vx, generic)
+G4TRACE_INSN(vmsbc_vvm, generic)
+G4TRACE_INSN(vmsbc_vxm, generic)
+G4TRACE_INSN(vmsbf_m, generic)
+G4TRACE_INSN(vmseq_vi, generic)
+G4TRACE_INSN(vmseq_vv, generic)
+G4TRACE_INSN(vmseq_vx, generic)
+G4TRACE_INSN(vmsgt_vi, generic)
+G4TRACE_INSN(vmsgt_vx, generic)
+G4TRACE_INSN(vmsgtu_vi, generic)
+G4TRACE_INSN(vmsgtu_vx, generic)
+G4TRACE_INSN(vmsif_m, generic)
+G4TRACE_INSN(vmsle_vi, generic)
+G4TRACE_INSN(vmsle_vv, generic)
+G4TRACE_INSN(vmsle_vx, generic)
+G4TRACE_INSN(vmsleu_vi, generic)
+G4TRACE_INSN(vmsleu_vv, generic)
+G4TRACE_INSN(vmsleu_vx, generic)
+G4TRACE_INSN(vmslt_vv, generic)
+G4TRACE_INSN(vmslt_vx, generic)
+G4TRACE_INSN(vmsltu_vv, generic)
+G4TRACE_INSN(vmsltu_vx, generic)
+G4TRACE_INSN(vmsne_vi, generic)
+G4TRACE_INSN(vmsne_vv, generic)
+G4TRACE_INSN(vmsne_vx, generic)
+G4TRACE_INSN(vmsof_m, generic)
+G4TRACE_INSN(vmerge_vim, generic)
+G4TRACE_INSN(vmerge_vvm, generic)
+G4TRACE_INSN(vmerge_vxm, generic)
+G4TRACE_INSN(vfirst_m, generic)
+G4TRACE_INSN(vmfle_vf, generic)
+G4TRACE_INSN(vmfle_vv, generic)
+G4TRACE_INSN(vmflt_vf, generic)
+G4TRACE_INSN(vmflt_vv, generic)
+G4TRACE_INSN(vfsgnj_vf, generic)
+G4TRACE_INSN(vfsgnj_vv, generic)
+G4TRACE_INSN(vfsgnjn_vf, generic)
+G4TRACE_INSN(vfsgnjn_vv, generic)
+G4TRACE_INSN(vfsgnjx_vf, generic)
+G4TRACE_INSN(vfsgnjx_vv, generic)
+G4TRACE_INSN(vrgather_vi, generic)
+G4TRACE_INSN(vrgather_vv, generic)
+G4TRACE_INSN(vrgather_vx, generic)
+G4TRACE_INSN(vrgatherei16_vv, generic)
+G4TRACE_INSN(vfslide1down_vf, generic)
+G4TRACE_INSN(vfslide1up_vf, generic)
+G4TRACE_INSN(vcompress_vm, generic)
+G4TRACE_INSN(vnsra_wi, generic)
+G4TRACE_INSN(vnsra_wv, generic)
+G4TRACE_INSN(vnsra_wx, generic)
+G4TRACE_INSN(vnsrl_wi, generic)
+G4TRACE_INSN(vnsrl_wv, generic)
+G4TRACE_INSN(vnsrl_wx, generic)
+
+// Vector floating point fused multiply-add
+G4TRACE_INSN(vfmacc_vf, fp_mul)
+G4TRACE_INSN(vfmacc_vv, fp_mul)
+G4TRACE_INSN(vfmadd_vf, fp_mul)
+G4TRACE_INSN(vfmadd_vv, fp_mul)
+G4TRACE_INSN(vfnmacc_vf, fp_mul)
+G4TRACE_INSN(vfnmacc_vv, fp_mul)
+G4TRACE_INSN(vfnmadd_vf, fp_mul)
+G4TRACE_INSN(vfnmadd_vv, fp_mul)
+G4TRACE_INSN(vfnmsac_vf, fp_mul)
+G4TRACE_INSN(vfnmsac_vv, fp_mul)
+G4TRACE_INSN(vfnmsub_vf, fp_mul)
+G4TRACE_INSN(vfnmsub_vv, fp_mul)
+G4TRACE_INSN(vfmsac_vf, fp_mul)
+G4TRACE_INSN(vfmsac_vv, fp_mul)
+G4TRACE_INSN(vfmsub_vf, fp_mul)
+G4TRACE_INSN(vfmsub_vv, fp_mul)
+
+// CSR accesses
+G4TRACE_INSN(csrrc, generic)
+G4TRACE_INSN(csrrci, generic)
+G4TRACE_INSN(csrrs, generic)
+G4TRACE_INSN(csrrsi, generic)
+G4TRACE_INSN(csrrw, generic)
+G4TRACE_INSN(csrrwi, generic)
+
+// Zcmp/Zcmt push, pop and table jumps are not modeled yet
+G4TRACE_INSN(cm_push, unknown)
+G4TRACE_INSN(cm_pop, unknown)
+G4TRACE_INSN(cm_popret, unknown)
+G4TRACE_INSN(cm_popretz, unknown)
+G4TRACE_INSN(cm_mva01s, unknown)
+G4TRACE_INSN(cm_mvsa01, unknown)
+G4TRACE_INSN(cm_jalt, unknown)
@@ -51,6 +51,27 @@ reg_t logged_rv64i_NAME(processor_t* p, insn_t insn, reg_t pc)
   #undef xlen
 }
 
+#undef DECODE_MACRO_USAGE_LOGGED
+#define DECODE_MACRO_USAGE_LOGGED 2
+
+reg_t g4trace_rv32i_NAME(processor_t* p, insn_t insn, reg_t pc)
+{
+  #define xlen 32
+  PROLOGUE;
+  #include "insns/NAME.h"
+  EPILOGUE;
+  #undef xlen
+}
+
+reg_t g4trace_rv64i_NAME(processor_t* p, insn_t insn, reg_t pc)
+{
+  #define xlen 64
+  PROLOGUE;
+  #include "insns/NAME.h"
+  EPILOGUE;
+  #undef xlen
+}
+
 #undef CHECK_REG
 #define CHECK_REG(reg) require((reg) < 16)
 
@@ -95,3 +116,24 @@ reg_t logged_rv64e_NAME(processor_t* p, insn_t insn, reg_t pc)
   EPILOGUE;
   #undef xlen
 }
+
+#undef DECODE_MACRO_USAGE_LOGGED
+#define DECODE_MACRO_USAGE_LOGGED 2
+
+reg_t g4trace_rv32e_NAME(processor_t* p, insn_t insn, reg_t pc)
+{
+  #define xlen 32
+  PROLOGUE;
+  #include "insns/NAME.h"
+  EPILOGUE;
+  #undef xlen
+}
+
+reg_t g4trace_rv64e_NAME(processor_t* p, insn_t insn, reg_t pc)
+{
+  #define xlen 64
+  PROLOGUE;
+  #include "insns/NAME.h"
+  EPILOGUE;
+  #undef xlen
+}
@@ -23,6 +23,7 @@ if (STATE.dcsr->v && STATE.dcsr->prv == PRV_U)
 
 /* We're not in Debug Mode anymore. */
 STATE.debug_mode = false;
+MMU.switch_tlb_context(); // MPRV may take effect again
 
 if (STATE.dcsr->step)
   STATE.single_step = STATE.STEP_STEPPING;
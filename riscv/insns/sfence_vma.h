@@ -6,4 +6,9 @@ if (STATE.v) {
 } else {
   require_privilege(get_field(STATE.mstatus->read(), MSTATUS_TVM) ? PRV_M : PRV_S);
 }
-MMU.flush_tlb();
+if (insn.rs1() != 0)
+  MMU.flush_tlb_vaddr(RS1);
+else if (insn.rs2() != 0)
+  MMU.flush_tlb_asid(RS2);
+else
+  MMU.flush_tlb();
@@ -0,0 +1,270 @@
+// See LICENSE for license details.
+
+#include "jit.h"
+#include "mmu.h"
+#include "processor.h"
+#include <string.h>
+#if defined(__x86_64__) && !defined(_WIN32)
+#include <sys/mman.h>
+#define JIT_X86_64 1
+#endif
+
+#define DEFINE_INSN(name) \
+  extern reg_t fast_rv64i_##name(processor_t*, insn_t, reg_t);
+DEFINE_INSN(add) DEFINE_INSN(sub) DEFINE_INSN(sll) DEFINE_INSN(slt)
+DEFINE_INSN(sltu) DEFINE_INSN(xor) DEFINE_INSN(srl) DEFINE_INSN(sra)
+DEFINE_INSN(or) DEFINE_INSN(and) DEFINE_INSN(mul)
+DEFINE_INSN(addi) DEFINE_INSN(slti) DEFINE_INSN(sltiu) DEFINE_INSN(xori)
+DEFINE_INSN(ori) DEFINE_INSN(andi) DEFINE_INSN(slli) DEFINE_INSN(srli)
+DEFINE_INSN(srai) DEFINE_INSN(lui) DEFINE_INSN(auipc)
+DEFINE_INSN(addw) DEFINE_INSN(subw) DEFINE_INSN(sllw) DEFINE_INSN(srlw)
+DEFINE_INSN(sraw) DEFINE_INSN(mulw) DEFINE_INSN(addiw) DEFINE_INSN(slliw)
+DEFINE_INSN(srliw) DEFINE_INSN(sraiw)
+DEFINE_INSN(c_addi) DEFINE_INSN(c_li) DEFINE_INSN(c_lui) DEFINE_INSN(c_mv)
+DEFINE_INSN(c_add) DEFINE_INSN(c_slli) DEFINE_INSN(c_srli) DEFINE_INSN(c_srai)
+DEFINE_INSN(c_andi) DEFINE_INSN(c_sub) DEFINE_INSN(c_xor) DEFINE_INSN(c_or)
+DEFINE_INSN(c_and) DEFINE_INSN(c_subw) DEFINE_INSN(c_addw)
+#undef DEFINE_INSN
+
+// An instruction of a translated run: rd = rs1 <kind> (rs2 or imm), with the
+// result sign-extended from 32 bits for the RV64 *W instructions
+struct jit_t::op_t {
+  enum kind_t { ADD, SUB, SLL, SLT, SLTU, XOR, SRL, SRA, OR, AND, MUL, AUIPC } kind;
+  unsigned rd, rs1, rs2;
+  bool has_imm;
+  reg_t imm;
+  bool word;
+};
+
+// Host code of one instruction is at most 39 bytes (two 64-bit immediate
+// moves, the operation, sign extension and the store)
+static const size_t MAX_OP_CODE = 48;
+static const size_t MAX_RUN_CODE = (MAX_BLOCK_INSNS + 1) * MAX_OP_CODE;
+
+bool jit_t::supported()
+{
+#ifdef JIT_X86_64
+  return true;
+#else
+  return false;
+#endif
+}
+
+jit_t::jit_t(processor_t* proc) : proc(proc)
+{
+#ifdef JIT_X86_64
+  size = 4 << 20;
+  void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    size = 0;
+  else
+    code = (uint8_t*)p;
+#endif
+}
+
+jit_t::~jit_t()
+{
+#ifdef JIT_X86_64
+  if (code)
+    munmap(code, size);
+#endif
+}
+
+bool jit_t::decode(const insn_block_t* block, size_t i, op_t& op)
+{
+  const insn_block_entry_t& e = block->insns[i];
+  if (e.fused)
+    return false;
+
+  insn_t insn = e.insn;
+  auto f = e.func;
+  auto r = [&](op_t::kind_t kind, bool word = false) {
+    op = {kind, unsigned(insn.rd()), unsigned(insn.rs1()), unsigned(insn.rs2()), false, 0, word};
+    return true;
+  };
+  auto i_imm = [&](op_t::kind_t kind, reg_t imm, bool word = false) {
+    op = {kind, unsigned(insn.rd()), unsigned(insn.rs1()), 0, true, imm, word};
+    return true;
+  };
+  // rd = rs1 op rs2 / imm with the compressed register fields
+  auto c = [&](op_t::kind_t kind, unsigned rd, unsigned rs1, unsigned rs2, bool has_imm, reg_t imm, bool word = false) {
+    op = {kind, rd, rs1, rs2, has_imm, imm, word};
+    return true;
+  };
+
+  if (f == fast_rv64i_add) return r(op_t::ADD);
+  if (f == fast_rv64i_sub) return r(op_t::SUB);
+  if (f == fast_rv64i_sll) return r(op_t::SLL);
+  if (f == fast_rv64i_slt) return r(op_t::SLT);
+  if (f == fast_rv64i_sltu) return r(op_t::SLTU);
+  if (f == fast_rv64i_xor) return r(op_t::XOR);
+  if (f == fast_rv64i_srl) return r(op_t::SRL);
+  if (f == fast_rv64i_sra) return r(op_t::SRA);
+  if (f == fast_rv64i_or) return r(op_t::OR);
+  if (f == fast_rv64i_and) return r(op_t::AND);
+  if (f == fast_rv64i_addw) return r(op_t::ADD, true);
+  if (f == fast_rv64i_subw) return r(op_t::SUB, true);
+  if (f == fast_rv64i_sllw) return r(op_t::SLL, true);
+  if (f == fast_rv64i_srlw) return r(op_t::SRL, true);
+  if (f == fast_rv64i_sraw) return r(op_t::SRA, true);
+  if (f == fast_rv64i_addi) return i_imm(op_t::ADD, insn.i_imm());
+  if (f == fast_rv64i_slti) return i_imm(op_t::SLT, insn.i_imm());
+  if (f == fast_rv64i_sltiu) return i_imm(op_t::SLTU, insn.i_imm());
+  if (f == fast_rv64i_xori) return i_imm(op_t::XOR, insn.i_imm());
+  if (f == fast_rv64i_ori) return i_imm(op_t::OR, insn.i_imm());
+  if (f == fast_rv64i_andi) return i_imm(op_t::AND, insn.i_imm());
+  if (f == fast_rv64i_slli) return i_imm(op_t::SLL, insn.shamt());
+  if (f == fast_rv64i_srli) return i_imm(op_t::SRL, insn.shamt());
+  if (f == fast_rv64i_srai) return i_imm(op_t::SRA, insn.shamt());
+  if (f == fast_rv64i_addiw) return i_imm(op_t::ADD, insn.i_imm(), true);
+  if (f == fast_rv64i_slliw) return i_imm(op_t::SLL, insn.shamt(), true);
+  if (f == fast_rv64i_srliw) return i_imm(op_t::SRL, insn.shamt(), true);
+  if (f == fast_rv64i_sraiw) return i_imm(op_t::SRA, insn.shamt(), true);
+  if (f == fast_rv64i_lui) return c(op_t::ADD, insn.rd(), 0, 0, true, insn.u_imm());
+  if (f == fast_rv64i_auipc) return c(op_t::AUIPC, insn.rd(), 0, 0, true, insn.u_imm());
+
+  // The extension checks of the remaining instructions are evaluated here;
+  // misa writes flush the translations.
+  if (proc->extension_enabled('M') || proc->extension_enabled(EXT_ZMMUL)) {
+    if (f == fast_rv64i_mul) return r(op_t::MUL);
+    if (f == fast_rv64i_mulw) return r(op_t::MUL, true);
+  }
+
+  if (!proc->extension_enabled(EXT_ZCA))
+    return false;
+
+  unsigned rd = insn.rvc_rd(), rs1s = insn.rvc_rs1s(), rs2s = insn.rvc_rs2s();
+  if (f == fast_rv64i_c_addi) return c(op_t::ADD, rd, rd, 0, true, insn.rvc_imm());
+  if (f == fast_rv64i_c_li) return c(op_t::ADD, rd, 0, 0, true, insn.rvc_imm());
+  if (f == fast_rv64i_c_lui && rd != 2 && insn.rvc_imm() != 0)
+    return c(op_t::ADD, rd, 0, 0, true, insn.rvc_imm() << 12);
+  if (f == fast_rv64i_c_mv && insn.rvc_rs2() != 0) return c(op_t::ADD, rd, 0, insn.rvc_rs2(), false, 0);
+  if (f == fast_rv64i_c_add && insn.rvc_rs2() != 0) return c(op_t::ADD, rd, rd, insn.rvc_rs2(), false, 0);
+  if (f == fast_rv64i_c_slli) return c(op_t::SLL, rd, rd, 0, true, insn.rvc_zimm());
+  if (f == fast_rv64i_c_srli) return c(op_t::SRL, rs1s, rs1s, 0, true, insn.rvc_zimm());
+  if (f == fast_rv64i_c_srai) return c(op_t::SRA, rs1s, rs1s, 0, true, insn.rvc_zimm());
+  if (f == fast_rv64i_c_andi) return c(op_t::AND, rs1s, rs1s, 0, true, insn.rvc_imm());
+  if (f == fast_rv64i_c_sub) return c(op_t::SUB, rs1s, rs1s, rs2s, false, 0);
+  if (f == fast_rv64i_c_xor) return c(op_t::XOR, rs1s, rs1s, rs2s, false, 0);
+  if (f == fast_rv64i_c_or) return c(op_t::OR, rs1s, rs1s, rs2s, false, 0);
+  if (f == fast_rv64i_c_and) return c(op_t::AND, rs1s, rs1s, rs2s, false, 0);
+  if (f == fast_rv64i_c_subw) return c(op_t::SUB, rs1s, rs1s, rs2s, false, 0, true);
+  if (f == fast_rv64i_c_addw) return c(op_t::ADD, rs1s, rs1s, rs2s, false, 0, true);
+
+  return false;
+}
+
+void jit_t::emit(const void* bytes, size_t len)
+{
+  memcpy(code + used, bytes, len);
+  used += len;
+}
+
+// Host registers: rax (0) and rcx (1) hold the operands, r8 points to the
+// integer register file and rdx holds the pc of the run (third argument).
+static const int RAX = 0, RCX = 1;
+
+void jit_t::emit_load(int host_reg, unsigned reg)
+{
+  // mov host_reg, [r8 + 8 * reg]
+  uint8_t insn[] = {0x49, 0x8b, uint8_t(0x80 | host_reg << 3)};
+  uint32_t disp = reg * sizeof(reg_t);
+  emit(insn, sizeof(insn));
+  emit(&disp, sizeof(disp));
+}
+
+void jit_t::emit_imm(int host_reg, reg_t imm)
+{
+  // movabs host_reg, imm
+  uint8_t insn[] = {0x48, uint8_t(0xb8 | host_reg)};
+  emit(insn, sizeof(insn));
+  emit(&imm, sizeof(imm));
+}
+
+void jit_t::emit_op(const op_t& op, reg_t offset)
+{
+  if (op.rd == 0)
+    return;
+
+  if (op.kind == op_t::AUIPC) {
+    emit_imm(RAX, op.imm + offset);
+    emit("\x48\x01\xd0", 3); // add rax, rdx
+  } else {
+    emit_load(RAX, op.rs1);
+    if (op.has_imm)
+      emit_imm(RCX, op.imm);
+    else
+      emit_load(RCX, op.rs2);
+
+    // 32-bit operations for the *W instructions, which also take the shift
+    // amount modulo 32
+    if (!op.word)
+      emit("\x48", 1);
+    switch (op.kind) {
+      case op_t::ADD: emit("\x01\xc8", 2); break; // add rax, rcx
+      case op_t::SUB: emit("\x29\xc8", 2); break; // sub rax, rcx
+      case op_t::AND: emit("\x21\xc8", 2); break; // and rax, rcx
+      case op_t::OR: emit("\x09\xc8", 2); break;  // or rax, rcx
+      case op_t::XOR: emit("\x31\xc8", 2); break; // xor rax, rcx
+      case op_t::SLL: emit("\xd3\xe0", 2); break; // shl rax, cl
+      case op_t::SRL: emit("\xd3\xe8", 2); break; // shr rax, cl
+      case op_t::SRA: emit("\xd3\xf8", 2); break; // sar rax, cl
+      case op_t::MUL: emit("\x0f\xaf\xc1", 3); break; // imul rax, rcx
+      case op_t::SLT: // cmp rax, rcx; setl al; movzx eax, al
+        emit("\x39\xc8\x0f\x9c\xc0\x0f\xb6\xc0", 8);
+        break;
+      case op_t::SLTU: // cmp rax, rcx; setb al; movzx eax, al
+        emit("\x39\xc8\x0f\x92\xc0\x0f\xb6\xc0", 8);
+        break;
+      default:
+        abort();
+    }
+    if (op.word)
+      emit("\x48\x63\xc0", 3); // movsxd rax, eax
+  }
+
+  // mov [r8 + 8 * rd], rax
+  uint32_t disp = op.rd * sizeof(reg_t);
+  emit("\x49\x89\x80", 3);
+  emit(&disp, sizeof(disp));
+}
+
+void jit_t::translate(insn_block_t* block)
+{
+  if (!code || proc->get_xlen() != 64 || proc->extension_enabled('E'))
+    return;
+
+  reg_t* xpr = const_cast<reg_t*>(&proc->get_state()->XPR[0]);
+  size_t out = 0;
+  for (size_t i = 0; i < block->size; ) {
+    op_t op;
+    size_t end = i;
+    while (end < block->size && decode(block, end, op))
+      end++;
+
+    // Single instructions are cheaper to call than to enter host code for
+    if (end - i < 2 || size - used < MAX_RUN_CODE) {
+      block->insns[out++] = block->insns[i++];
+      continue;
+    }
+
+    // reg_t run(processor_t* p, insn_t insn, reg_t pc): returns the pc
+    // after the run
+    auto run = (insn_func_t)(code + used);
+    emit("\x49\xb8", 2); // movabs r8, xpr
+    emit(&xpr, sizeof(xpr));
+    reg_t offset = 0;
+    for (size_t j = i; j < end; j++) {
+      decode(block, j, op);
+      emit_op(op, offset);
+      offset += insn_length(block->insns[j].insn.bits());
+    }
+    emit_imm(RAX, offset);
+    emit("\x48\x01\xd0\xc3", 4); // add rax, rdx; ret
+
+    insn_block_entry_t entry = {run, block->insns[i].insn, block->insns[end - 1].npc, end - i - 1};
+    block->insns[out++] = entry;
+    i = end;
+  }
+  block->size = out;
+}
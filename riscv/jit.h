@@ -0,0 +1,54 @@
+// See LICENSE for license details.
+#ifndef _RISCV_JIT_H
+#define _RISCV_JIT_H
+
+#include "decode.h"
+#include <cstddef>
+#include <cstdint>
+
+class processor_t;
+struct insn_block_t;
+
+// Translates hot superblocks into x86-64 code (--jit). Runs of integer ALU
+// instructions become straight-line host code that reads and writes the
+// integer registers in place; everything else (memory accesses, which keep
+// using the mmu_t TLB fast path, control flow, CSR, FP, vector, system
+// instructions) still goes through its insn_func_t. Translated code cannot
+// trap, so the interpreter state is exact whenever control leaves it.
+//
+// Superblocks only exist on the fast path (see processor_t::slow_path), so
+// translation is off whenever commit logging, g4trace ROIs, debug mode or
+// triggers are active.
+class jit_t
+{
+public:
+  // Whether translation is implemented for the host
+  static bool supported();
+
+  jit_t(processor_t* proc);
+  ~jit_t();
+
+  // Replace the translatable runs in the block with host code
+  void translate(insn_block_t* block);
+
+  // Reuse the whole code buffer; only called when no block refers to it
+  void reset() { used = 0; }
+
+  // Executions of a superblock before it is translated
+  static const unsigned THRESHOLD = 8;
+
+private:
+  struct op_t;
+  bool decode(const insn_block_t* block, size_t i, op_t& op);
+  void emit(const void* bytes, size_t len);
+  void emit_load(int host_reg, unsigned reg);
+  void emit_imm(int host_reg, reg_t imm);
+  void emit_op(const op_t& op, reg_t offset);
+
+  processor_t* proc;
+  uint8_t* code = nullptr;
+  size_t used = 0;
+  size_t size = 0;
+};
+
+#endif
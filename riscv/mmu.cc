@@ -6,6 +6,9 @@
 #include "simif.h"
 #include "processor.h"
 #include "decode_macros.h"
+#include "jit.h"
+#include <iomanip>
+#include <iostream>
 
 mmu_t::mmu_t(simif_t* sim, endianness_t endianness, processor_t* proc)
  : sim(sim), proc(proc),
@@ -19,25 +22,290 @@ mmu_t::mmu_t(simif_t* sim, endianness_t endianness, processor_t* proc)
 #ifndef RISCV_ENABLE_DUAL_ENDIAN
   assert(endianness == endianness_little);
 #endif
-  flush_tlb();
+  set_tlb_entries(DEFAULT_TLB_ENTRIES);
   yield_load_reservation();
 }
 
 mmu_t::~mmu_t()
 {
+  if (!print_tlb_stats)
+    return;
+
+  const tlb_stats_t& s = tlb_stats;
+  uint64_t accesses = 0, misses = 0;
+  for (int type : {FETCH, LOAD, STORE}) {
+    accesses += s.hits[type] + s.misses[type];
+    misses += s.misses[type];
+  }
+  float mr = accesses ? 100.0f * misses / accesses : 0.0f;
+  std::string name = "C" + std::to_string(proc ? proc->get_id() : 0) + " TLB ";
+
+  std::cout << std::setprecision(3) << std::fixed;
+  std::cout << name << "Fetch Hits:            " << s.hits[FETCH] << std::endl;
+  std::cout << name << "Fetch Misses:          " << s.misses[FETCH] << std::endl;
+  std::cout << name << "Load Hits:             " << s.hits[LOAD] << std::endl;
+  std::cout << name << "Load Misses:           " << s.misses[LOAD] << std::endl;
+  std::cout << name << "Store Hits:            " << s.hits[STORE] << std::endl;
+  std::cout << name << "Store Misses:          " << s.misses[STORE] << std::endl;
+  std::cout << name << "Miss Rate:             " << mr << '%' << std::endl;
+  std::cout << name << "Superpage Hits:        " << s.superpage_hits << std::endl;
+  std::cout << name << "Page Walks:            " << s.walks << std::endl;
+  std::cout << name << "PTE Loads:             " << s.pte_loads << std::endl;
+  std::cout << name << "PTE Cache Hits:        " << s.pte_cache_hits << std::endl;
+  std::cout << name << "Context Switches:      " << s.context_switches << std::endl;
+  std::cout << name << "Context Reuses:        " << s.context_reuses << std::endl;
+  std::cout << name << "Full Flushes:          " << s.full_flushes << std::endl;
+  std::cout << name << "Address Flushes:       " << s.vaddr_flushes << std::endl;
+  std::cout << name << "ASID Flushes:          " << s.asid_flushes << std::endl;
 }
 
 void mmu_t::flush_icache()
 {
   for (size_t i = 0; i < ICACHE_ENTRIES; i++)
     icache[i].tag = -1;
+
+  flush_blocks();
+}
+
+void mmu_t::flush_blocks()
+{
+  for (size_t i = 0; i < BLOCK_ENTRIES; i++)
+    blocks[i].tag = -1;
+  if (jit)
+    jit->reset();
+
+  if (!block_pages.empty()) {
+    block_pages.clear();
+    for (size_t i = 0; i < tlb_entries; i++)
+      if (tlb_store[i].tag != reg_t(-1))
+        tlb_store[i].tag &= ~TLB_CHECK_CODE;
+  }
+}
+
+// Whether the instruction may continue anywhere but at the next one, or
+// change how the following ones are fetched or decoded (e.g. fence.i, CSR
+// writes). Blocks end after such instructions.
+static bool insn_ends_block(insn_bits_t bits)
+{
+  switch (insn_length(bits)) {
+    case 2: {
+      auto quadrant = bits & 3, funct3 = (bits >> 13) & 7;
+      // c.jal, c.j, c.beqz, c.bnez; c.jr, c.jalr, c.ebreak, Zcmp, Zcmt
+      return (quadrant == 1 && (funct3 == 1 || funct3 >= 5)) ||
+             (quadrant == 2 && (funct3 == 4 || funct3 == 5));
+    }
+    case 4: {
+      auto opcode = bits & 0x7f;
+      // branches, jal, jalr, SYSTEM, MISC-MEM
+      return opcode == 0x63 || opcode == 0x6f || opcode == 0x67 ||
+             opcode == 0x73 || opcode == 0x0f;
+    }
+    default:
+      return true;
+  }
+}
+
+insn_block_t* mmu_t::refill_block(reg_t addr, insn_block_t* block)
+{
+  // Only pages in plain memory with a valid instruction TLB entry, so that
+  // fetching ahead within the page has no side effects and cannot trap
+  auto [tlb_hit, _, paddr] = access_tlb(tlb_insn, addr);
+  if (!tlb_hit)
+    return nullptr;
+
+  block->tag = -1;
+  block->size = 0;
+  reg_t pc = addr;
+  do {
+    auto entry = access_icache(pc);
+    if (unlikely(entry->tag != pc))
+      return nullptr;
+    insn_bits_t bits = entry->data.insn.bits();
+    reg_t npc = pc + insn_length(bits);
+    block->insns[block->size++] = {entry->data.func, entry->data.insn, npc, 0};
+    if (insn_ends_block(bits))
+      break;
+    pc = npc;
+  } while (block->size < MAX_BLOCK_INSNS && pc % PGSIZE <= PGSIZE - sizeof(insn_bits_t));
+
+  // Stores to this page must now go through perform_intrapage_store
+  if (block_pages.insert(paddr >> PGSHIFT).second)
+    flush_tlb_entries(tlb_store);
+
+  block->ninsns = block->size;
+  block->jit_countdown = jit ? jit_t::THRESHOLD : 0;
+  block->tag = addr;
+  return block;
+}
+
+void mmu_t::translate_block(insn_block_t* block)
+{
+  jit->translate(block);
+}
+
+void mmu_t::set_jit(bool enable)
+{
+  jit.reset(enable ? new jit_t(proc) : nullptr);
+  flush_blocks();
+}
+
+void mmu_t::set_tlb_entries(size_t n)
+{
+  assert(n > 0 && (n & (n - 1)) == 0);
+  tlb_entries = n;
+  tlb_storage.resize(3 * n);
+  tlb_insn = &tlb_storage[0];
+  tlb_load = &tlb_storage[n];
+  tlb_store = &tlb_storage[2 * n];
+  flush_tlb();
+}
+
+void mmu_t::flush_tlb_entries(dtlb_entry_t* tlb)
+{
+  memset(tlb, -1, tlb_entries * sizeof(dtlb_entry_t));
 }
 
 void mmu_t::flush_tlb()
 {
-  memset(tlb_insn, -1, sizeof(tlb_insn));
-  memset(tlb_load, -1, sizeof(tlb_load));
-  memset(tlb_store, -1, sizeof(tlb_store));
+  flush_tlb_entries(tlb_insn);
+  flush_tlb_entries(tlb_load);
+  flush_tlb_entries(tlb_store);
+  memset(superpages, -1, sizeof(superpages));
+  flush_pte_cache();
+  tlb_stats.full_flushes++;
+
+  // All context ids are free again
+  tlb_contexts.clear();
+  next_tlb_context_id = 0;
+  new_tlb_context();
+
+  flush_icache();
+}
+
+tlb_context_key_t mmu_t::tlb_context_key() const
+{
+  // Only the state that the current privilege level translates with, so
+  // that e.g. M-mode keeps its entries across satp writes
+  if (!proc || !proc->state.mstatus || !proc->state.satp)
+    return {};
+  const state_t& state = proc->state;
+  tlb_context_key_t key = {};
+  key.prv = state.prv;
+  key.v = state.v;
+  key.mprv = in_mprv();
+  if (state.prv != PRV_M || key.mprv) {
+    key.status = state.mstatus->read() & (MSTATUS_MXR | MSTATUS_SUM);
+    if (state.v) {
+      key.vsatp = state.vsatp->read();
+      key.hgatp = state.hgatp->read();
+      key.status |= (state.vsstatus->read() & (MSTATUS_MXR | MSTATUS_SUM)) << 32;
+    } else {
+      key.satp = state.satp->readvirt(false);
+    }
+  }
+  return key;
+}
+
+void mmu_t::new_tlb_context()
+{
+  if (next_tlb_context_id == TLB_CONTEXT_IDS) {
+    flush_tlb();
+    return;
+  }
+
+  if (tlb_contexts.size() == TLB_CONTEXTS)
+    tlb_contexts.erase(tlb_contexts.begin());
+  reg_t id = next_tlb_context_id++;
+  tlb_contexts.push_back({tlb_context_key(), id});
+  tlb_context_page_shift[id] = PGSHIFT;
+  set_tlb_context(id);
+}
+
+void mmu_t::set_tlb_context(reg_t id)
+{
+  tlb_context = id << TLB_CONTEXT_SHIFT;
+  // Fibonacci hashing spreads consecutive ids evenly over the TLB
+  int index_bits = ctz(tlb_entries);
+  tlb_index_salt = index_bits ? (id * 0x9e3779b97f4a7c15ULL) >> (64 - index_bits) : 0;
+}
+
+void mmu_t::switch_tlb_context()
+{
+  auto key = tlb_context_key();
+  if (tlb_contexts.back().key == key)
+    return;
+
+  tlb_stats.context_switches++;
+  // The icache and superblocks are indexed by virtual address only
+  flush_icache();
+
+  for (auto it = tlb_contexts.begin(); it != tlb_contexts.end(); ++it) {
+    if (it->key == key) {
+      auto context = *it;
+      tlb_contexts.erase(it);
+      tlb_contexts.push_back(context);
+      set_tlb_context(context.id);
+      tlb_stats.context_reuses++;
+      return;
+    }
+  }
+  new_tlb_context();
+}
+
+void mmu_t::flush_tlb_vaddr(reg_t vaddr)
+{
+  tlb_stats.vaddr_flushes++;
+
+  // Pointer masking may have put tags into the upper bits of the virtual
+  // addresses in the TLB, so ignore those (and flush a few pages too many)
+  const reg_t vpn_mask = (reg_t(1) << (48 - PGSHIFT)) - 1;
+  reg_t vpn = vaddr >> PGSHIFT;
+  for (auto& entry : tlb_storage) {
+    if (entry.tag == reg_t(-1))
+      continue;
+    reg_t id = (entry.tag >> TLB_CONTEXT_SHIFT) & 0xff;
+    int shift = tlb_context_page_shift[id] - PGSHIFT;
+    if ((((entry.tag ^ vpn) & vpn_mask) >> shift) == 0)
+      entry.tag = -1;
+  }
+
+  int idxbits = proc && proc->get_const_xlen() == 32 ? 10 : 9;
+  for (auto& by_level : superpages) {
+    for (int level = 0; level < SUPERPAGE_LEVELS; level++) {
+      int shift = (level + 1) * idxbits;
+      for (auto& entry : by_level[level])
+        if (entry.tag != reg_t(-1) && (((entry.tag << shift) ^ vpn) & vpn_mask) >> shift == 0)
+          entry.tag = -1;
+    }
+  }
+
+  for (auto& entry : pte_cache)
+    if (entry.paddr != reg_t(-1) && (((entry.region >> PGSHIFT) ^ vpn) & vpn_mask) >> (entry.shift - PGSHIFT) == 0)
+      entry.paddr = -1;
+
+  flush_icache();
+}
+
+void mmu_t::flush_tlb_asid(reg_t asid)
+{
+  tlb_stats.asid_flushes++;
+
+  // Drop the contexts that translate with this ASID; their ids are not
+  // handed out again, so their entries are as good as flushed
+  bool virt = proc->state.v;
+  auto uses_asid = [&](const tlb_context_t& context) {
+    const tlb_context_key_t& key = context.key;
+    if (key.v != virt)
+      return false;
+    reg_t atp = virt ? key.vsatp : key.satp;
+    return (proc->get_const_xlen() == 32 ? get_field(atp, SATP32_ASID) : get_field(atp, SATP64_ASID)) == asid;
+  };
+  bool current = uses_asid(tlb_contexts.back());
+  std::erase_if(tlb_contexts, uses_asid);
+  if (current)
+    new_tlb_context();
+  // Any level of the page tables may have changed
+  flush_pte_cache();
 
   flush_icache();
 }
@@ -90,6 +358,7 @@ mmu_t::insn_parcel_t mmu_t::fetch_slow_path(reg_t vaddr)
 
   if  (auto [tlb_hit, host_addr, paddr] = access_tlb(tlb_insn, vaddr, TLB_FLAGS & ~TLB_CHECK_TRIGGERS); tlb_hit) {
     // Fast path for simple cases
+    tlb_stats.hits[FETCH]++;
     return perform_intrapage_fetch(vaddr, host_addr, paddr);
   }
 
@@ -245,6 +514,8 @@ void mmu_t::load_slow_path_intrapage(reg_t len, uint8_t* bytes, mem_access_info_
 
   if (access_info.flags.lr) {
     load_reservation_address = paddr;
+    if (host_atomics)
+      memcpy(&load_reservation_value, bytes, std::min(len, reg_t(sizeof(load_reservation_value))));
   }
 }
 
@@ -257,6 +528,7 @@ void mmu_t::load_slow_path(reg_t original_addr, reg_t len, uint8_t* bytes, xlate
     bool aligned = (original_addr & (len - 1)) == 0;
 
     if (likely(tlb_hit && (aligned || (intrapage && is_misaligned_enabled())))) {
+      tlb_stats.hits[LOAD]++;
       return perform_intrapage_load(original_addr, host_addr, paddr, len, bytes, xlate_flags);
     }
   }
@@ -289,13 +561,13 @@ void mmu_t::load_slow_path(reg_t original_addr, reg_t len, uint8_t* bytes, xlate
     bytes += sizeof(reg_t);
   }
   check_triggers(triggers::OPERATION_LOAD, transformed_addr, access_info.effective_virt, reg_from_bytes(len, bytes));
-
-  if (proc && unlikely(proc->get_log_commits_enabled()))
-    proc->state.log_mem_read.push_back(std::make_tuple(original_addr, 0, len));
 }
 
 inline void mmu_t::perform_intrapage_store(reg_t vaddr, uintptr_t host_addr, reg_t paddr, reg_t len, const uint8_t* bytes, xlate_flags_t xlate_flags)
 {
+  if (unlikely(!block_pages.empty()) && block_pages.count(paddr >> PGSHIFT))
+    flush_blocks();
+
   if (host_addr) {
      memcpy((char*)host_addr, bytes, len);
   } else if (!mmio_store(paddr, len, bytes)) {
@@ -332,6 +604,7 @@ void mmu_t::store_slow_path(reg_t original_addr, reg_t len, const uint8_t* bytes
     bool aligned = (original_addr & (len - 1)) == 0;
 
     if (likely(tlb_hit && (aligned || (intrapage && is_misaligned_enabled())))) {
+      tlb_stats.hits[STORE]++;
       if (actually_store)
         perform_intrapage_store(original_addr, host_addr, paddr, len, bytes, xlate_flags);
       return;
@@ -368,15 +641,13 @@ void mmu_t::store_slow_path(reg_t original_addr, reg_t len, const uint8_t* bytes
   } else {
     store_slow_path_intrapage(len, bytes, access_info, actually_store);
   }
-
-  if (proc && unlikely(proc->get_log_commits_enabled()))
-    proc->state.log_mem_write.push_back(std::make_tuple(original_addr, reg_from_bytes(len, bytes), len));
 }
 
 tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_type type)
 {
-  reg_t idx = (vaddr >> PGSHIFT) % TLB_ENTRIES;
-  reg_t expected_tag = vaddr >> PGSHIFT;
+  tlb_stats.misses[type]++;
+  reg_t idx = ((vaddr >> PGSHIFT) + tlb_index_salt) & (tlb_entries - 1);
+  reg_t expected_tag = (vaddr >> PGSHIFT) | tlb_context;
   reg_t base_paddr = paddr & ~reg_t(PGSIZE - 1);
 
   tlb_entry_t entry = {uintptr_t(host_addr) - (vaddr % PGSIZE), paddr - (vaddr % PGSIZE)};
@@ -388,6 +659,7 @@ tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_
 
   auto trace_flag = tracer.interested_in_range(base_paddr, base_paddr + PGSIZE, type) ? TLB_CHECK_TRACER : 0;
   auto mmio_flag = host_addr ? 0 : TLB_MMIO;
+  auto code_flag = type == STORE && block_pages.count(base_paddr >> PGSHIFT) ? TLB_CHECK_CODE : 0;
 
   switch (type) {
     case FETCH:
@@ -400,7 +672,7 @@ tlb_entry_t mmu_t::refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_
       break;
     case STORE:
       tlb_store[idx].data = entry;
-      tlb_store[idx].tag = expected_tag | (check_triggers_store ? TLB_CHECK_TRIGGERS : 0) | trace_flag | mmio_flag;
+      tlb_store[idx].tag = expected_tag | (check_triggers_store ? TLB_CHECK_TRIGGERS : 0) | trace_flag | mmio_flag | code_flag;
       break;
     default:
       abort();
@@ -456,6 +728,34 @@ reg_t mmu_t::pmp_homogeneous(reg_t addr, reg_t len)
   return true;
 }
 
+mmu_t::pte_cache_entry_t& mmu_t::pte_cache_entry(reg_t pte_paddr, size_t ptesize)
+{
+  return pte_cache[((pte_paddr / ptesize) ^ (pte_paddr >> PGSHIFT)) % PTE_CACHE_ENTRIES];
+}
+
+void mmu_t::flush_pte_cache()
+{
+  for (auto& entry : pte_cache)
+    entry.paddr = -1;
+}
+
+reg_t mmu_t::walk_pte_load(reg_t pte_paddr, reg_t region, int shift, reg_t addr, bool virt, access_type trap_type, size_t ptesize)
+{
+  auto& entry = pte_cache_entry(pte_paddr, ptesize);
+  if (entry.paddr == pte_paddr && entry.shift == shift && ((entry.region ^ region) >> shift) == 0) {
+    tlb_stats.pte_cache_hits++;
+    return entry.pte;
+  }
+
+  tlb_stats.pte_loads++;
+  reg_t pte = pte_load(pte_paddr, addr, virt, trap_type, ptesize);
+  // Like the TLB, only keep what may be used: valid pointers and leaves
+  // that have been accessed (pte_store keeps the D bit up to date)
+  if ((pte & PTE_V) && (PTE_TABLE(pte) || (pte & PTE_A)))
+    entry = {pte_paddr, pte, region, shift};
+  return pte;
+}
+
 reg_t mmu_t::s2xlate(reg_t gva, reg_t gpa, access_type type, access_type trap_type, bool virt, bool hlvx, bool is_for_vs_pt_addr)
 {
   if (!virt)
@@ -487,7 +787,7 @@ reg_t mmu_t::s2xlate(reg_t gva, reg_t gpa, access_type type, access_type trap_ty
 
       // check that physical address of PTE is legal
       auto pte_paddr = base + idx * vm.ptesize;
-      reg_t pte = pte_load(pte_paddr, gva, virt, trap_type, vm.ptesize);
+      reg_t pte = walk_pte_load(pte_paddr, gpa, PGSHIFT + ptshift, gva, virt, trap_type, vm.ptesize);
       reg_t ppn = (pte & ~reg_t(PTE_ATTR)) >> PTE_PPN_SHIFT;
       bool pbmte = proc->get_state()->menvcfg->read() & MENVCFG_PBMTE;
       bool hade = proc->get_state()->menvcfg->read() & MENVCFG_ADUE;
@@ -582,6 +882,21 @@ reg_t mmu_t::walk(mem_access_info_t access_info)
   if (masked_msbs != 0 && masked_msbs != mask)
     vm.levels = 0;
 
+  // The superpage entries are tagged with the context of the current
+  // privilege level, so they only serve its regular accesses
+  bool use_superpages = !virt && !access_info.flags.is_special_access() && !in_mprv();
+  if (use_superpages) {
+    for (int i = 1; i < vm.levels; i++) {
+      int shift = PGSHIFT + i * vm.idxbits;
+      auto& entry = superpages[type][i - 1][(addr >> shift) % SUPERPAGE_ENTRIES];
+      if (entry.tag == ((addr >> shift) | tlb_context)) {
+        tlb_stats.superpage_hits++;
+        return entry.page_base | (addr & ((reg_t(1) << shift) - 1) & ~page_mask);
+      }
+    }
+  }
+  tlb_stats.walks++;
+
   reg_t base = vm.ptbase;
   for (int i = vm.levels - 1; i >= 0; i--) {
     int ptshift = i * vm.idxbits;
@@ -589,7 +904,7 @@ reg_t mmu_t::walk(mem_access_info_t access_info)
 
     // check that physical address of PTE is legal
     auto pte_paddr = s2xlate(addr, base + idx * vm.ptesize, LOAD, type, virt, false, true);
-    reg_t pte = pte_load(pte_paddr, addr, virt, type, vm.ptesize);
+    reg_t pte = walk_pte_load(pte_paddr, addr, PGSHIFT + ptshift, addr, virt, type, vm.ptesize);
     reg_t ppn = (pte & ~reg_t(PTE_ATTR)) >> PTE_PPN_SHIFT;
     bool pbmte = virt ? (proc->get_state()->henvcfg->read() & HENVCFG_PBMTE) : (proc->get_state()->menvcfg->read() & MENVCFG_PBMTE);
     bool hade = virt ? (proc->get_state()->henvcfg->read() & HENVCFG_ADUE) : (proc->get_state()->menvcfg->read() & MENVCFG_ADUE);
@@ -657,6 +972,16 @@ reg_t mmu_t::walk(mem_access_info_t access_info)
                         | (vpn & ((reg_t(1) << napot_bits) - 1))
                         | (vpn & ((reg_t(1) << ptshift) - 1))) << PGSHIFT;
       reg_t phys = page_base | (addr & page_mask);
+
+      auto& page_shift = tlb_context_page_shift[tlb_context >> TLB_CONTEXT_SHIFT];
+      page_shift = std::max<int>(page_shift, PGSHIFT + ptshift + napot_bits);
+      if (use_superpages && ptshift != 0 && napot_bits == 0) {
+        int shift = PGSHIFT + ptshift;
+        auto& entry = superpages[type][i - 1][(addr >> shift) % SUPERPAGE_ENTRIES];
+        entry.tag = (addr >> shift) | tlb_context;
+        entry.page_base = page_base & ~((reg_t(1) << shift) - 1);
+      }
+
       return s2xlate(addr, phys, type, type, virt, hlvx, false) & ~page_mask;
     }
   }
@@ -13,6 +13,9 @@
 #include "triggers.h"
 #include "cfg.h"
 #include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <unordered_set>
 #include <vector>
 
 // virtual memory configuration
@@ -28,7 +31,7 @@ const reg_t PGSIZE = 1 << PGSHIFT;
 #endif
 
 #define MMU_OBSERVE_LOAD(addr, data, length) \
-  if (unlikely(proc && (proc->get_log_commits_enabled() || proc->get_log_g4trace_enabled()))) { \
+  if (unlikely(proc && proc->get_log_accesses_enabled())) { \
     proc->state.log_mem_read.push_back(std::make_tuple(addr, 0, length)); \
   }
 
@@ -37,7 +40,7 @@ const reg_t PGSIZE = 1 << PGSHIFT;
 #endif
 
 #define MMU_OBSERVE_STORE(addr, data, length) \
-  if (unlikely(proc && (proc->get_log_commits_enabled() || proc->get_log_g4trace_enabled()))) {  \
+  if (unlikely(proc && proc->get_log_accesses_enabled())) {  \
     proc->state.log_mem_write.push_back(std::make_tuple(addr, val, length)); \
   }
 
@@ -45,6 +48,8 @@ const reg_t PGSIZE = 1 << PGSHIFT;
 #define MMU_OBSERVE_STORE(addr, data, length)
 #endif
 
+class jit_t;
+
 struct insn_fetch_t
 {
   insn_func_t func;
@@ -58,6 +63,25 @@ struct icache_entry_t {
   insn_fetch_t data;
 };
 
+// A superblock: straight-line instructions from one page, executed back to
+// back without per-instruction icache lookups (see processor_t::step)
+struct insn_block_entry_t {
+  insn_func_t func;
+  insn_t insn;
+  reg_t npc; // fall-through pc
+  size_t fused; // instructions after the first executed by func (--jit)
+};
+
+static const size_t MAX_BLOCK_INSNS = 16;
+
+struct insn_block_t {
+  reg_t tag;
+  size_t size;
+  size_t ninsns; // instructions, including fused ones
+  unsigned jit_countdown; // executions left before translation (--jit)
+  insn_block_entry_t insns[MAX_BLOCK_INSNS];
+};
+
 struct tlb_entry_t {
   uintptr_t host_addr;
   reg_t target_addr;
@@ -68,6 +92,35 @@ struct dtlb_entry_t {
   reg_t tag;
 };
 
+// The translation state that TLB entries depend on. Each recently used
+// combination gets a small id that is part of the TLB tags, so switching
+// between address spaces or privilege levels does not flush the TLB.
+struct tlb_context_key_t {
+  reg_t satp;
+  reg_t vsatp;
+  reg_t hgatp;
+  reg_t status; // MXR and SUM of mstatus and vsstatus
+  reg_t prv;
+  bool v;
+  bool mprv;
+  bool operator==(const tlb_context_key_t&) const = default;
+};
+
+// TLB counters, printed at exit with --tlb-stats
+struct tlb_stats_t {
+  uint64_t hits[3]; // indexed by access_type
+  uint64_t misses[3];
+  uint64_t superpage_hits; // misses that found their superpage
+  uint64_t walks;
+  uint64_t pte_loads; // by walks, from memory
+  uint64_t pte_cache_hits;
+  uint64_t context_switches;
+  uint64_t context_reuses; // switches to a context that was still tagged
+  uint64_t full_flushes;
+  uint64_t vaddr_flushes;
+  uint64_t asid_flushes;
+};
+
 struct xlate_flags_t {
   const bool forced_virt : 1 {false};
   const bool hlvx : 1 {false};
@@ -110,6 +163,7 @@ public:
     auto [tlb_hit, host_addr, _] = access_tlb(tlb_load, addr);
 
     if (likely(!xlate_flags.is_special_access() && aligned && tlb_hit)) {
+      tlb_stats.hits[LOAD]++;
       res = *(target_endian<T>*)host_addr;
     } else {
       load_slow_path(addr, sizeof(T), (uint8_t*)&res, xlate_flags);
@@ -150,6 +204,7 @@ public:
     auto [tlb_hit, host_addr, _] = access_tlb(tlb_store, addr);
 
     if (!xlate_flags.is_special_access() && likely(aligned && tlb_hit)) {
+      tlb_stats.hits[STORE]++;
       *(target_endian<T>*)host_addr = to_target(val);
     } else {
       target_endian<T> target_val = to_target(val);
@@ -185,13 +240,68 @@ public:
       throw trap_store_guest_page_fault(t.get_tval(), t.get_tval2(), t.get_tinst()); \
     }
 
+  // When harts run on several host threads (sim_t::set_threads), AMOs and
+  // SCs to memory that is mapped in the TLB use host atomic instructions.
+  // Returns the host address of addr, or nullptr if the access must take the
+  // regular path (MMIO, tracers, triggers or single-threaded simulation).
+  template<typename T>
+  target_endian<T>* host_atomic_addr(reg_t addr, bool need_load = true) {
+    if (likely(!host_atomics) || sizeof(T) > sizeof(uint64_t))
+      return nullptr;
+    auto [store_hit, host_addr, _] = access_tlb(tlb_store, addr);
+    if (!store_hit || (need_load && !std::get<0>(access_tlb(tlb_load, addr))))
+      return nullptr;
+    return (target_endian<T>*)host_addr;
+  }
+
+  template<typename T>
+  bool host_compare_exchange(target_endian<T>* host_addr, target_endian<T>& expected, T desired) {
+    if constexpr (sizeof(T) <= sizeof(uint64_t)) {
+      target_endian<T> target_desired = to_target(desired);
+      return __atomic_compare_exchange(host_addr, &expected, &target_desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+    abort(); // host_atomic_addr returns nullptr for wider types
+  }
+
+  // Atomically replaces the value lhs (just loaded from addr) with f(lhs),
+  // updating lhs if another hart changed it meanwhile
+  template<typename T, typename op>
+  bool host_amo(reg_t addr, op f, T& lhs) {
+    auto host_addr = host_atomic_addr<T>(addr);
+    if (!host_addr)
+      return false;
+    target_endian<T> old = to_target(lhs);
+    T val;
+    do {
+      lhs = from_target(old);
+      val = f(lhs);
+    } while (!host_compare_exchange(host_addr, old, val));
+    MMU_OBSERVE_STORE(addr, val, sizeof(T));
+    return true;
+  }
+
+  template<typename T>
+  bool host_amo_compare_and_swap(reg_t addr, T comp, T swap, T& lhs) {
+    auto host_addr = host_atomic_addr<T>(addr);
+    if (!host_addr)
+      return false;
+    target_endian<T> old = to_target(comp);
+    if (host_compare_exchange(host_addr, old, swap)) {
+      T val = swap;
+      MMU_OBSERVE_STORE(addr, val, sizeof(T));
+    }
+    lhs = from_target(old);
+    return true;
+  }
+
   // template for functions that perform an atomic memory operation
   template<typename T, typename op>
   T amo(reg_t addr, op f) {
     convert_load_traps_to_store_traps({
       store_slow_path(addr, sizeof(T), nullptr, {}, false, true);
       auto lhs = load<T>(addr);
-      store<T>(addr, f(lhs));
+      if (!host_amo<T>(addr, f, lhs))
+        store<T>(addr, f(lhs));
       return lhs;
     })
   }
@@ -214,7 +324,7 @@ public:
     convert_load_traps_to_store_traps({
       store_slow_path(addr, sizeof(T), nullptr, {}, false, true);
       auto lhs = load<T>(addr);
-      if (lhs == comp)
+      if (!host_amo_compare_and_swap<T>(addr, comp, swap, lhs) && lhs == comp)
         store<T>(addr, swap);
       return lhs;
     })
@@ -295,6 +405,21 @@ public:
   {
     bool have_reservation = check_load_reservation(addr, sizeof(T));
 
+    if (have_reservation && unlikely(host_atomics)) {
+      // Another hart may have written the location since the LR: succeed
+      // only if it still holds the value that the LR returned
+      store_slow_path(addr, sizeof(T), nullptr, {}, false, true);
+      if (auto host_addr = host_atomic_addr<T>(addr, false)) {
+        target_endian<T> reserved;
+        memcpy(&reserved, &load_reservation_value, sizeof(T));
+        have_reservation = host_compare_exchange(host_addr, reserved, val);
+        if (have_reservation)
+          MMU_OBSERVE_STORE(addr, val, sizeof(T));
+        yield_load_reservation();
+        return have_reservation;
+      }
+    }
+
     if (have_reservation)
       store(addr, val);
 
@@ -367,6 +492,21 @@ public:
     return refill_icache(addr, entry);
   }
 
+  static const reg_t BLOCK_ENTRIES = 256;
+
+  // Returns nullptr where blocks are not built (e.g. MMIO or traced pages);
+  // the caller then executes from the icache.
+  inline insn_block_t* access_block(reg_t addr)
+  {
+    insn_block_t* block = &blocks[(addr / PC_ALIGN) % BLOCK_ENTRIES];
+    if (likely(block->tag == addr)) {
+      if (unlikely(block->jit_countdown) && --block->jit_countdown == 0)
+        translate_block(block);
+      return block;
+    }
+    return refill_block(addr, block);
+  }
+
   inline insn_fetch_t load_insn(reg_t addr)
   {
     icache_entry_t entry;
@@ -376,8 +516,8 @@ public:
   std::tuple<bool, uintptr_t, reg_t> ALWAYS_INLINE access_tlb(const dtlb_entry_t* tlb, reg_t vaddr, reg_t allowed_flags = 0, reg_t required_flags = 0)
   {
     auto vpn = vaddr / PGSIZE, pgoff = vaddr % PGSIZE;
-    auto& entry = tlb[vpn % TLB_ENTRIES];
-    auto hit = likely((entry.tag & (~allowed_flags | required_flags)) == (vpn | required_flags));
+    auto& entry = tlb[(vpn + tlb_index_salt) & (tlb_entries - 1)];
+    auto hit = likely((entry.tag & (~allowed_flags | required_flags)) == (vpn | tlb_context | required_flags));
     bool mmio = allowed_flags & TLB_MMIO & entry.tag;
     auto host_addr = mmio ? 0 : entry.data.host_addr + pgoff;
     auto paddr = entry.data.target_addr + pgoff;
@@ -385,7 +525,14 @@ public:
   }
 
   void flush_tlb();
+  // sfence.vma with rs1 or rs2 other than x0: only flush the pages that
+  // translate vaddr, or the address spaces with this ASID
+  void flush_tlb_vaddr(reg_t vaddr);
+  void flush_tlb_asid(reg_t asid);
+  // Called whenever the state in tlb_context_key_t changes
+  void switch_tlb_context();
   void flush_icache();
+  void flush_blocks();
 
   void register_memtracer(memtracer_t*);
 
@@ -414,27 +561,118 @@ public:
     blocksz = size;
   }
 
+  // Translate hot superblocks into host code (--jit)
+  void set_jit(bool enable);
+
+  // Entries in each of the fetch, load and store TLBs (--tlb-entries);
+  // a power of 2
+  void set_tlb_entries(size_t n);
+  void set_tlb_stats(bool enable)
+  {
+    print_tlb_stats = enable;
+  }
+  const tlb_stats_t& get_tlb_stats() const
+  {
+    return tlb_stats;
+  }
+
+  void set_host_atomics(bool enable)
+  {
+    host_atomics = enable;
+  }
+
 private:
   simif_t* sim;
   processor_t* proc;
   memtracer_list_t tracer;
   reg_t load_reservation_address;
+  uint64_t load_reservation_value; // only used with host_atomics
   reg_t blocksz;
+  bool host_atomics = false;
 
   // implement an instruction cache for simulator performance
   icache_entry_t icache[ICACHE_ENTRIES];
 
+  // superblocks built from the icache, and the physical pages they come
+  // from; stores to those pages invalidate them
+  insn_block_t blocks[BLOCK_ENTRIES];
+  std::unordered_set<reg_t> block_pages;
+  insn_block_t* refill_block(reg_t addr, insn_block_t* block);
+  std::unique_ptr<jit_t> jit;
+  void translate_block(insn_block_t* block);
+
   // implement a TLB for simulator performance
-  static const reg_t TLB_ENTRIES = 256;
+  static const reg_t DEFAULT_TLB_ENTRIES = 256;
   // If a TLB tag has TLB_CHECK_TRIGGERS set, then the MMU must check for a
   // trigger match before completing an access.
   static const reg_t TLB_CHECK_TRIGGERS = reg_t(1) << 63;
   static const reg_t TLB_CHECK_TRACER = reg_t(1) << 62;
   static const reg_t TLB_MMIO = reg_t(1) << 61;
-  static const reg_t TLB_FLAGS = TLB_CHECK_TRIGGERS | TLB_CHECK_TRACER | TLB_MMIO;
-  dtlb_entry_t tlb_load[TLB_ENTRIES];
-  dtlb_entry_t tlb_store[TLB_ENTRIES];
-  dtlb_entry_t tlb_insn[TLB_ENTRIES];
+  // Set in store TLB entries of pages that hold superblocks
+  static const reg_t TLB_CHECK_CODE = reg_t(1) << 60;
+  static const reg_t TLB_FLAGS = TLB_CHECK_TRIGGERS | TLB_CHECK_TRACER | TLB_MMIO | TLB_CHECK_CODE;
+  // The id of the translation context sits between the VPN and the flags.
+  // Flushed tags are all ones, so the last id is never handed out.
+  static const int TLB_CONTEXT_SHIFT = 52;
+  static const reg_t TLB_VPN_MASK = (reg_t(1) << TLB_CONTEXT_SHIFT) - 1;
+  static const reg_t TLB_CONTEXT_IDS = 255;
+  std::vector<dtlb_entry_t> tlb_storage;
+  dtlb_entry_t* tlb_load;
+  dtlb_entry_t* tlb_store;
+  dtlb_entry_t* tlb_insn;
+  reg_t tlb_entries;
+  tlb_stats_t tlb_stats = {};
+  bool print_tlb_stats = false;
+  void flush_tlb_entries(dtlb_entry_t* tlb);
+
+  // Recently used translation contexts, least recently used first. Contexts
+  // that drop out keep their id (and their entries can never hit again)
+  // until a full flush makes all ids available again.
+  struct tlb_context_t {
+    tlb_context_key_t key;
+    reg_t id;
+  };
+  static const size_t TLB_CONTEXTS = 16;
+  std::vector<tlb_context_t> tlb_contexts;
+  reg_t next_tlb_context_id;
+  reg_t tlb_context; // the current id, shifted into tag position
+  // Added to the VPN to index the TLBs, so that address spaces with the
+  // same layout do not all compete for the same entries
+  reg_t tlb_index_salt;
+  void set_tlb_context(reg_t id);
+  // log2 of the largest page that each context has mapped, for flushing
+  // all the TLB entries that a superpage was split into
+  uint8_t tlb_context_page_shift[TLB_CONTEXT_IDS];
+  tlb_context_key_t tlb_context_key() const;
+  void new_tlb_context();
+
+  // Superpages found by walk(), so that each of their 4 KiB pages that
+  // misses the TLB does not walk the page tables again. Indexed by access
+  // type and level (2 MiB / 4 MiB and up); only for accesses without
+  // two-stage translation, MPRV or special flags.
+  struct superpage_entry_t {
+    reg_t tag; // VPN at this level | tlb_context
+    reg_t page_base;
+  };
+  static const int SUPERPAGE_LEVELS = 4;
+  static const size_t SUPERPAGE_ENTRIES = 16;
+  superpage_entry_t superpages[3][SUPERPAGE_LEVELS][SUPERPAGE_ENTRIES];
+
+  // PTEs read by walk() and s2xlate(), by physical address, for both
+  // stages. Each entry only serves the region of (guest) addresses it was
+  // read for, so that flush_tlb_vaddr can drop the entries for an address
+  // at all levels, like the TLB entries for it.
+  struct pte_cache_entry_t {
+    reg_t paddr;
+    reg_t pte;
+    reg_t region; // an address the PTE translates
+    int shift; // log2 of the size of the region that the PTE maps
+  };
+  static const size_t PTE_CACHE_ENTRIES = 256;
+  pte_cache_entry_t pte_cache[PTE_CACHE_ENTRIES];
+  pte_cache_entry_t& pte_cache_entry(reg_t pte_paddr, size_t ptesize);
+  void flush_pte_cache();
+  reg_t walk_pte_load(reg_t pte_paddr, reg_t region, int shift, reg_t addr, bool virt, access_type trap_type, size_t ptesize);
 
   // finish translation on a TLB miss and update the TLB
   tlb_entry_t refill_tlb(reg_t vaddr, reg_t paddr, char* host_addr, access_type type);
@@ -475,6 +713,10 @@ private:
   }
 
   void pte_store(reg_t pte_paddr, reg_t new_pte, reg_t addr, bool virt, access_type trap_type, size_t ptesize) {
+    auto& entry = pte_cache_entry(pte_paddr, ptesize);
+    if (entry.paddr == pte_paddr)
+      entry.pte = new_pte;
+
     if (ptesize == 4)
       return pte_store<uint32_t>(pte_paddr, new_pte, addr, virt, trap_type);
     else
@@ -515,8 +757,10 @@ private:
   }
 
   inline insn_parcel_t fetch_insn_parcel(reg_t addr) {
-    if (auto [tlb_hit, host_addr, paddr] = access_tlb(tlb_insn, addr); tlb_hit)
+    if (auto [tlb_hit, host_addr, paddr] = access_tlb(tlb_insn, addr); tlb_hit) {
+      tlb_stats.hits[FETCH]++;
       return from_le(*(insn_parcel_t*)host_addr);
+    }
 
     return from_le(fetch_slow_path(addr));
   }
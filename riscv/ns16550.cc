@@ -6,6 +6,7 @@
 #include "term.h"
 #include "sim.h"
 #include "dts.h"
+#include "checkpoint.h"
 
 #define UART_QUEUE_SIZE         64
 
@@ -302,6 +303,33 @@ bool ns16550_t::store(reg_t addr, size_t len, const uint8_t* bytes)
   return ret;
 }
 
+void ns16550_t::save_state(std::ostream& o)
+{
+  for (uint8_t r : {dll, dlm, iir, ier, fcr, lcr, mcr, lsr, msr, scr})
+    checkpoint_put(o, r);
+  checkpoint_put(o, backoff_counter);
+  auto rx = rx_queue;
+  checkpoint_put(o, rx.size());
+  for (; !rx.empty(); rx.pop())
+    checkpoint_put(o, rx.front());
+}
+
+void ns16550_t::restore_state(std::istream& i)
+{
+  for (uint8_t* r : {&dll, &dlm, &iir, &ier, &fcr, &lcr, &mcr, &lsr, &msr, &scr})
+    checkpoint_get(i, *r);
+  checkpoint_get(i, backoff_counter);
+  size_t n;
+  checkpoint_get(i, n);
+  rx_queue = {};
+  for (size_t k = 0; k < n; k++) {
+    uint8_t byte;
+    checkpoint_get(i, byte);
+    rx_queue.push(byte);
+  }
+  update_interrupt();
+}
+
 void ns16550_t::tick(reg_t UNUSED rtc_ticks)
 {
   if (!(fcr & UART_FCR_ENABLE_FIFO) ||
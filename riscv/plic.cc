@@ -5,6 +5,7 @@
 #include "simif.h"
 #include "sim.h"
 #include "dts.h"
+#include "checkpoint.h"
 
 #define PLIC_MAX_CONTEXTS 15872
 
@@ -327,6 +328,35 @@ void plic_t::set_interrupt_level(uint32_t id, int lvl)
   }
 }
 
+void plic_t::save_state(std::ostream& o)
+{
+  checkpoint_put(o, priority);
+  checkpoint_put(o, level);
+  checkpoint_put(o, contexts.size());
+  for (const auto& c : contexts) {
+    checkpoint_put(o, c.priority_threshold);
+    checkpoint_put(o, c.enable);
+    checkpoint_put(o, c.pending);
+    checkpoint_put(o, c.pending_priority);
+    checkpoint_put(o, c.claimed);
+  }
+}
+
+void plic_t::restore_state(std::istream& i)
+{
+  checkpoint_get(i, priority);
+  checkpoint_get(i, level);
+  checkpoint_check(i, contexts.size(), "number of PLIC contexts");
+  for (auto& c : contexts) {
+    checkpoint_get(i, c.priority_threshold);
+    checkpoint_get(i, c.enable);
+    checkpoint_get(i, c.pending);
+    checkpoint_get(i, c.pending_priority);
+    checkpoint_get(i, c.claimed);
+    context_update(&c);
+  }
+}
+
 bool plic_t::load(reg_t addr, size_t len, uint8_t* bytes)
 {
   bool ret = false;
@@ -12,6 +12,7 @@
 #include "platform.h"
 #include "vector_unit.h"
 #include "debug_defines.h"
+#include "checkpoint.h"
 #include <cinttypes>
 #include <cmath>
 #include <cstdlib>
@@ -173,10 +174,133 @@ void processor_t::reset()
     e.second->reset(*this);
   }
 
+  // The translation state was reinitialized
+  mmu->flush_tlb();
+
   if (sim)
     sim->proc_reset(id);
 }
 
+void processor_t::save_state(std::ostream& o)
+{
+  checkpoint_put(o, state.pc);
+  for (int i = 0; i < NXPR; i++)
+    checkpoint_put(o, state.XPR[i]);
+  for (int i = 0; i < NFPR; i++)
+    checkpoint_put(o, state.FPR[i]);
+  checkpoint_put(o, state.prv);
+  checkpoint_put(o, state.v);
+  checkpoint_put(o, state.debug_mode);
+  checkpoint_put(o, state.serialized);
+  checkpoint_put(o, state.elp);
+  checkpoint_put(o, state.critical_error);
+  checkpoint_put(o, in_wfi);
+
+  // CSRs in address order, read with V=0 so that the virtualized supervisor
+  // CSRs give their own values. Reading seed has side effects, and its value
+  // does not need to be preserved.
+  std::map<reg_t, reg_t> csrs;
+  bool v = state.v;
+  state.v = false;
+  for (const auto& [addr, csr] : state.csrmap)
+    if (addr != CSR_SEED)
+      csrs[addr] = csr->read();
+  state.v = v;
+  checkpoint_put(o, csrs.size());
+  for (const auto& [addr, val] : csrs) {
+    checkpoint_put(o, addr);
+    checkpoint_put(o, val);
+  }
+
+  if (any_vector_extensions()) {
+    checkpoint_put(o, VU.vlmax);
+    checkpoint_put(o, VU.vma);
+    checkpoint_put(o, VU.vta);
+    checkpoint_put(o, VU.vsew);
+    checkpoint_put(o, VU.vflmul);
+    checkpoint_put(o, VU.vill);
+    checkpoint_put(o, VU.vstart_alu);
+    checkpoint_put_bytes(o, VU.reg_file, NVPR * VU.vlenb);
+  }
+}
+
+void processor_t::restore_state(std::istream& i)
+{
+  checkpoint_get(i, state.pc);
+  for (int r = 0; r < NXPR; r++) {
+    reg_t val;
+    checkpoint_get(i, val);
+    state.XPR.write(r, val);
+  }
+  for (int r = 0; r < NFPR; r++) {
+    freg_t val;
+    checkpoint_get(i, val);
+    state.FPR.write(r, val);
+  }
+  checkpoint_get(i, state.prv);
+  bool v;
+  checkpoint_get(i, v);
+  checkpoint_get(i, state.debug_mode);
+  checkpoint_get(i, state.serialized);
+  checkpoint_get(i, state.elp);
+  checkpoint_get(i, state.critical_error);
+  checkpoint_get(i, in_wfi);
+
+  size_t n;
+  checkpoint_get(i, n);
+  std::vector<std::pair<reg_t, reg_t>> csrs(n);
+  for (auto& [addr, val] : csrs) {
+    checkpoint_get(i, addr);
+    checkpoint_get(i, val);
+  }
+  // Write the PMP configurations last, so that locked entries do not prevent
+  // restoring their addresses.
+  auto is_pmpcfg = [](reg_t addr) { return addr >= CSR_PMPCFG0 && addr <= CSR_PMPCFG15; };
+  std::stable_partition(csrs.begin(), csrs.end(), [&](const auto& c) { return !is_pmpcfg(c.first); });
+  // Writing the FP and vector CSRs requires mstatus.FS/VS to be enabled (and
+  // marks them dirty), so mstatus is written again at the end.
+  state.v = false;
+  state.mstatus->write(state.mstatus->read() | MSTATUS_FS | MSTATUS_VS);
+  for (const auto& [addr, val] : csrs) {
+    auto search = state.csrmap.find(addr);
+    if (search == state.csrmap.end())
+      throw std::runtime_error("checkpoint was saved with a different ISA");
+    // Read-only CSRs ignore the write, and CSRs that alias others get the
+    // values that were written through them.
+    search->second->write(val);
+    // Writing a counter expects a bump before the next write
+    state.minstret->bump(0);
+    state.mcycle->bump(0);
+  }
+  auto mstatus = std::find_if(csrs.begin(), csrs.end(), [](const auto& c) { return c.first == CSR_MSTATUS; });
+  if (mstatus != csrs.end())
+    state.mstatus->write(mstatus->second);
+  state.v = v;
+  // The interrupt bits that are read-only in mip are driven by devices
+  auto mip = std::find_if(csrs.begin(), csrs.end(), [](const auto& c) { return c.first == CSR_MIP; });
+  if (mip != csrs.end())
+    state.mip->backdoor_write_with_mask(~reg_t(0), mip->second);
+
+  if (any_vector_extensions()) {
+    auto vl = std::find_if(csrs.begin(), csrs.end(), [](const auto& c) { return c.first == CSR_VL; });
+    auto vtype = std::find_if(csrs.begin(), csrs.end(), [](const auto& c) { return c.first == CSR_VTYPE; });
+    if (vl != csrs.end())
+      VU.vl->write_raw(vl->second);
+    if (vtype != csrs.end())
+      VU.vtype->write_raw(vtype->second);
+    checkpoint_get(i, VU.vlmax);
+    checkpoint_get(i, VU.vma);
+    checkpoint_get(i, VU.vta);
+    checkpoint_get(i, VU.vsew);
+    checkpoint_get(i, VU.vflmul);
+    checkpoint_get(i, VU.vill);
+    checkpoint_get(i, VU.vstart_alu);
+    checkpoint_get_bytes(i, VU.reg_file, NVPR * VU.vlenb);
+  }
+
+  mmu->flush_tlb();
+}
+
 extension_t* processor_t::get_extension()
 {
   switch (custom_extensions.size()) {
@@ -323,13 +447,13 @@ reg_t processor_t::legalize_privilege(reg_t prv)
 
 void processor_t::set_privilege(reg_t prv, bool virt)
 {
-  mmu->flush_tlb();
   state.prev_prv = state.prv;
   state.prev_v = state.v;
   state.prv = legalize_privilege(prv);
   state.v = virt && state.prv != PRV_M;
   state.prv_changed = state.prv != state.prev_prv;
   state.v_changed = state.v != state.prev_v;
+  mmu->switch_tlb_context();
 }
 
 const char* processor_t::get_privilege_string()
@@ -633,6 +757,20 @@ reg_t illegal_instruction(processor_t UNUSED *p, insn_t insn, reg_t UNUSED pc)
   throw trap_illegal_instruction(insn.bits() & 0xffffffffULL);
 }
 
+// Executed on the fast path in place of the g4trace START_TRACING and BEGIN_ROI
+// hints while the hart is not logging. It activates logging and returns
+// PC_SWITCH_TO_LOGGED without executing the hint, so that the hint itself is
+// executed again, and traced, by the logged slow path.
+static reg_t g4trace_roi_start_hint(processor_t* p, insn_t insn, reg_t pc)
+{
+  if (p->get_stop_at_start_tracing() && insn.bits() == 0x40205013 /* srai zero, zero, 2 */)
+    return PC_STOP_AT_START_TRACING;
+  if (!p->get_log_g4trace_enabled())
+    return pc + insn_length(insn.bits()); // the hints are nops
+  p->set_log_active(true);
+  return PC_SWITCH_TO_LOGGED;
+}
+
 processor_t::decoded_insn_t processor_t::decode_insn(insn_t insn)
 {
   // look up opcode in hash table
@@ -642,21 +780,17 @@ processor_t::decoded_insn_t processor_t::decode_insn(insn_t insn)
   bool rve = extension_enabled('E');
 
   if (unlikely(!hit)) {
-    // fall back to linear search
-    auto matching = [insn_bits = insn.bits()](const insn_desc_t &d) {
-      return (insn_bits & d.mask) == d.match;
-    };
-    auto p = std::find_if(custom_instructions.begin(),
-                          custom_instructions.end(), matching);
-    if (p == custom_instructions.end()) {
-      p = std::find_if(instructions.begin(), instructions.end(), matching);
-      assert(p != instructions.end());
-    }
-    desc = &*p;
+    size_t i = decode_tree.lookup(insn.bits());
+    assert(i < decode_tree_insns.size());
+    desc = decode_tree_insns[i];
     opcode_cache[idx].replace(insn.bits(), desc);
   }
 
-  auto exec_func = desc->func(xlen, rve, (log_commits_enabled || get_log_g4trace_enabled()) && log_active);
+  auto exec_func = desc->func(xlen, rve, (log_commits_enabled || get_log_g4trace_enabled()) && log_active,
+                              !log_commits_enabled);
+  if (unlikely((get_log_g4trace_enabled() && !log_active) || stop_at_start_tracing) && !slow_path() &&
+      (insn.bits() == 0x40205013 /* srai zero, zero, 2 */ || insn.bits() == 0x40005013 /* srai zero, zero, 0 */))
+    exec_func = g4trace_roi_start_hint;
   auto g4_func = desc->g4trace_decoder;
 
   return {exec_func, g4_func};
@@ -676,6 +810,17 @@ void processor_t::build_opcode_map()
 {
   for (size_t i = 0; i < OPCODE_CACHE_SIZE; i++)
     opcode_cache[i].reset();
+
+  // Custom instructions take precedence over the base ones
+  std::vector<insn_decode_tree_t::pattern_t> patterns;
+  decode_tree_insns.clear();
+  for (auto list : {&custom_instructions, &instructions}) {
+    for (const insn_desc_t& desc : *list) {
+      patterns.push_back({desc.mask, desc.match});
+      decode_tree_insns.push_back(&desc);
+    }
+  }
+  decode_tree.build(patterns);
 }
 
 void processor_t::register_extension(extension_t *x) {
@@ -710,7 +855,11 @@ void processor_t::register_base_instructions()
     extern reg_t logged_rv32i_##name(processor_t*, insn_t, reg_t); \
     extern reg_t logged_rv64i_##name(processor_t*, insn_t, reg_t); \
     extern reg_t logged_rv32e_##name(processor_t*, insn_t, reg_t); \
-    extern reg_t logged_rv64e_##name(processor_t*, insn_t, reg_t);
+    extern reg_t logged_rv64e_##name(processor_t*, insn_t, reg_t); \
+    extern reg_t g4trace_rv32i_##name(processor_t*, insn_t, reg_t); \
+    extern reg_t g4trace_rv64i_##name(processor_t*, insn_t, reg_t); \
+    extern reg_t g4trace_rv32e_##name(processor_t*, insn_t, reg_t); \
+    extern reg_t g4trace_rv64e_##name(processor_t*, insn_t, reg_t);
   #include "insn_list.h"
   #undef DEFINE_INSN
 
@@ -726,7 +875,11 @@ void processor_t::register_base_instructions()
       logged_rv64i_##name, \
       logged_rv32e_##name, \
       logged_rv64e_##name,                    \
-      g4trace_get_decoder(#name) \
+      g4trace_get_decoder(#name), \
+      g4trace_rv32i_##name, \
+      g4trace_rv64i_##name, \
+      g4trace_rv32e_##name, \
+      g4trace_rv64e_##name \
     }; \
     register_base_insn(insn); \
   }
@@ -741,8 +894,7 @@ void processor_t::register_base_instructions()
   #undef DECLARE_OVERLAP_INSN
 
   // add all other instructions.  since they are non-overlapping, the order
-  // does not affect correctness, but more frequent instructions should
-  // appear earlier to improve search time on opcode_cache misses.
+  // does not matter.
   #define DEFINE_INSN(name) \
     if (!name##_overlapping) \
       DEFINE_INSN_UNCOND(name);
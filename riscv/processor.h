@@ -3,6 +3,7 @@
 #define _RISCV_PROCESSOR_H
 
 #include "decode.h"
+#include "decode_tree.h"
 #include "g4trace.h"
 #include "trap.h"
 #include "abstract_device.h"
@@ -11,6 +12,7 @@
 #include <vector>
 #include <unordered_map>
 #include <map>
+#include <algorithm>
 #include <cassert>
 #include "debug_rom_defines.h"
 #include "entropy_source.h"
@@ -48,9 +50,21 @@ struct insn_desc_t
 
   G4TraceDecoder g4trace_decoder;
 
-  insn_func_t func(int xlen, bool rve, bool logged) const
+  // Logged variants that record only what g4trace needs. Optional for custom
+  // instructions, which use their logged variants instead.
+  insn_func_t g4trace_rv32i;
+  insn_func_t g4trace_rv64i;
+  insn_func_t g4trace_rv32e;
+  insn_func_t g4trace_rv64e;
+
+  insn_func_t func(int xlen, bool rve, bool logged, bool g4trace_only = false) const
   {
-    if (logged)
+    if (logged && g4trace_only && g4trace_rv32i)
+      if (rve)
+        return xlen == 64 ? g4trace_rv64e : g4trace_rv32e;
+      else
+        return xlen == 64 ? g4trace_rv64i : g4trace_rv32i;
+    else if (logged)
       if (rve)
         return xlen == 64 ? logged_rv64e : logged_rv32e;
       else
@@ -66,7 +80,87 @@ struct insn_desc_t
 };
 
 // regnum, data
-typedef std::map<reg_t, freg_t> commit_log_reg_t;
+//
+// Registers accessed by the instruction being logged. An instruction accesses
+// only a few registers, so instead of a std::map this is a fixed-capacity array
+// kept sorted by regnum (iteration order is the same as the map's), which never
+// allocates. Membership of x, f and v registers is also tracked in bitmasks so
+// that count() is O(1).
+class commit_log_reg_t {
+public:
+  typedef std::pair<reg_t, freg_t> value_type;
+  typedef value_type* iterator;
+  typedef const value_type* const_iterator;
+
+  // 32 vector registers plus scalar operands, vstatus and CSRs
+  static const size_t capacity = 64;
+
+  freg_t& operator[](reg_t regnum) {
+    iterator i = lower_bound(regnum);
+    if (i == end() || i->first != regnum) {
+      insert_at(i, regnum);
+      i->second = freg_t();
+    }
+    return i->second;
+  }
+
+  // Records an access to regnum without its value (for g4trace-only logging).
+  void insert_id(reg_t regnum) {
+    iterator i = lower_bound(regnum);
+    if (i == end() || i->first != regnum)
+      insert_at(i, regnum);
+  }
+
+  iterator find(reg_t regnum) {
+    iterator i = lower_bound(regnum);
+    return i != end() && i->first == regnum ? i : end();
+  }
+  const_iterator find(reg_t regnum) const {
+    return const_cast<commit_log_reg_t*>(this)->find(regnum);
+  }
+
+  size_t count(reg_t regnum) const {
+    if (const uint32_t *m = const_cast<commit_log_reg_t*>(this)->regfile_mask(regnum))
+      return (*m >> (regnum >> 4)) & 1;
+    return find(regnum) != end();
+  }
+
+  void clear() {
+    entries_size = 0;
+    regfile_masks[0] = regfile_masks[1] = regfile_masks[2] = 0;
+  }
+
+  size_t size() const { return entries_size; }
+  bool empty() const { return entries_size == 0; }
+  iterator begin() { return entries; }
+  iterator end() { return entries + entries_size; }
+  const_iterator begin() const { return entries; }
+  const_iterator end() const { return entries + entries_size; }
+
+private:
+  value_type entries[capacity];
+  size_t entries_size = 0;
+  uint32_t regfile_masks[3] = {}; // x, f and v registers present
+
+  void insert_at(iterator i, reg_t regnum) {
+    assert(entries_size < capacity);
+    std::move_backward(i, end(), end() + 1);
+    ++entries_size;
+    i->first = regnum;
+    if (uint32_t *m = regfile_mask(regnum))
+      *m |= uint32_t(1) << (regnum >> 4);
+  }
+
+  iterator lower_bound(reg_t regnum) {
+    return std::lower_bound(begin(), end(), regnum,
+                            [](const value_type& e, reg_t r) { return e.first < r; });
+  }
+
+  uint32_t *regfile_mask(reg_t regnum) {
+    reg_t regfile = regnum & 0xf;
+    return regfile < 3 && (regnum >> 4) < 32 ? &regfile_masks[regfile] : nullptr;
+  }
+};
 
 // addr, value, size
 typedef std::vector<std::tuple<reg_t, uint64_t, uint8_t>> commit_log_mem_t;
@@ -275,11 +369,21 @@ public:
   G4TracePerProcState& get_log_g4_trace_state() { return get_state()->g4trace; }
   const G4TraceConfig* get_log_g4_trace_config() const { return get_state()->g4trace.global; }
   bool get_log_g4trace_enabled() const { return get_log_g4_trace_config() && get_log_g4_trace_config()->enable; }
+  // Whether register and memory accesses are recorded in state.log_*
+  bool get_log_accesses_enabled() const { return (log_commits_enabled || get_log_g4trace_enabled()) && log_active; }
   bool get_log_g4trace_has_started() const { return get_log_g4_trace_state().has_started; }
   void set_log_g4trace_has_started() { assert(!get_log_g4trace_has_started()); get_state()->g4trace.has_started = true; }
   uint64_t get_log_g4trace_max_instructions() const { return get_log_g4_trace_config()->max_trace_instructions; }
   void reset();
   void step(size_t n); // run for n cycles
+  // Hart state in checkpoints (see checkpoint.h)
+  void save_state(std::ostream& o);
+  void restore_state(std::istream& i);
+  // With --g4trace-checkpoint-at-roi, harts stop right before executing the
+  // START_TRACING hint, so that sim_t can save a checkpoint.
+  void set_stop_at_start_tracing(bool value) { stop_at_start_tracing = value; }
+  bool get_stop_at_start_tracing() const { return stop_at_start_tracing; }
+  bool get_stopped_at_start_tracing() const { return stopped_at_start_tracing; }
   void put_csr(int which, reg_t val);
   uint32_t get_id() const { return id; }
   reg_t get_csr(int which, insn_t insn, bool write, bool peek = 0);
@@ -409,6 +513,8 @@ private:
   FILE *log_file;
   bool log_active = false; // TODO: add option --log-use-roi-markers
   bool log_filter_privileged = true; // TODO: add option
+  bool stop_at_start_tracing = false;
+  bool stopped_at_start_tracing = false;
   std::ostream sout_; // needed for socket command interface -s, also used for -d and -l, but not for --log
   bool halt_on_reset;
   bool in_wfi;
@@ -426,6 +532,9 @@ private:
 
   static const size_t OPCODE_CACHE_SIZE = 4095;
   opcode_cache_entry_t opcode_cache[OPCODE_CACHE_SIZE];
+  // custom_instructions, then instructions, for opcode_cache misses
+  insn_decode_tree_t decode_tree;
+  std::vector<const insn_desc_t*> decode_tree_insns;
 
   void take_pending_interrupt() { take_interrupt(state.mip->read() & state.mie->read()); }
   void take_interrupt(reg_t mask); // take first enabled interrupt in mask
@@ -9,6 +9,7 @@
 #include "platform.h"
 #include "libfdt.h"
 #include "socketif.h"
+#include "checkpoint.h"
 #include <filesystem>
 #include <fstream>
 #include <map>
@@ -264,11 +265,13 @@ sim_t::sim_t(const cfg_t *cfg, bool halted,
 
 sim_t::~sim_t()
 {
-  g4trace_write_index(g4trace_global);
-  for (size_t i = 0; i < procs.size(); i++) {
+  stop_hart_threads();
+  // the frame offsets of asynchronously compressed traces are only known once they are closed
+  for (size_t i = 0; i < procs.size(); i++)
     g4trace_close_trace_file(procs[i]->get_log_g4_trace_state());
+  g4trace_write_index(g4trace_global);
+  for (size_t i = 0; i < procs.size(); i++)
     delete procs[i];
-  }
   delete debug_mmu;
 }
 
@@ -290,6 +293,7 @@ void sim_t::step(size_t n)
   {
     steps = std::min(n - i, INTERLEAVE - current_step);
     procs[current_proc]->step(steps);
+    bool checkpoint = procs[current_proc]->get_stopped_at_start_tracing();
 
     current_step += steps;
     if (current_step == INTERLEAVE)
@@ -302,6 +306,180 @@ void sim_t::step(size_t n)
         for (auto &dev : devices) dev->tick(rtc_ticks);
       }
     }
+
+    if (unlikely(checkpoint)) {
+      save_checkpoint();
+      htif_exit(0);
+      return;
+    }
+  }
+}
+
+void sim_t::set_threads(size_t n)
+{
+  nthreads = std::max<size_t>(1, std::min(n, procs.size()));
+  for (processor_t *proc : procs)
+    proc->get_mmu()->set_host_atomics(nthreads > 1);
+}
+
+void sim_t::set_jit(bool enable)
+{
+  for (processor_t *proc : procs)
+    proc->get_mmu()->set_jit(enable);
+}
+
+void sim_t::set_tlb_entries(size_t n)
+{
+  for (processor_t *proc : procs)
+    proc->get_mmu()->set_tlb_entries(n);
+}
+
+void sim_t::set_tlb_stats(bool enable)
+{
+  for (processor_t *proc : procs)
+    proc->get_mmu()->set_tlb_stats(enable);
+}
+
+void sim_t::step_parallel(size_t n)
+{
+  if (hart_threads.empty()) {
+    quantum_start = std::make_unique<std::barrier<>>(nthreads);
+    quantum_end = std::make_unique<std::barrier<>>(nthreads);
+    hart_thread_errors.resize(nthreads);
+    for (size_t t = 1; t < nthreads; t++)
+      hart_threads.emplace_back(&sim_t::hart_thread_main, this, t);
+  }
+
+  quantum_steps = n;
+  quantum_start->arrive_and_wait();
+  step_harts(0);
+  quantum_end->arrive_and_wait();
+
+  for (auto& error : hart_thread_errors)
+    if (error)
+      std::rethrow_exception(std::exchange(error, nullptr));
+
+  // All the harts are stopped: this is where they interact with the devices
+  // that are not accessed through MMIO, and with HTIF (in htif_t::run).
+  bool checkpoint = false;
+  for (processor_t *proc : procs) {
+    proc->get_mmu()->yield_load_reservation();
+    checkpoint |= proc->get_stopped_at_start_tracing();
+  }
+  reg_t rtc_ticks = n / INSNS_PER_RTC_TICK;
+  for (auto &dev : devices) dev->tick(rtc_ticks);
+
+  if (unlikely(checkpoint)) {
+    save_checkpoint();
+    htif_exit(0);
+  }
+}
+
+void sim_t::step_harts(size_t thread)
+{
+  try {
+    for (size_t i = thread; i < procs.size(); i += nthreads)
+      procs[i]->step(quantum_steps);
+  } catch (...) {
+    hart_thread_errors[thread] = std::current_exception();
+  }
+}
+
+void sim_t::hart_thread_main(size_t thread)
+{
+  while (true) {
+    quantum_start->arrive_and_wait();
+    if (hart_threads_exit)
+      return;
+    step_harts(thread);
+    quantum_end->arrive_and_wait();
+  }
+}
+
+void sim_t::stop_hart_threads()
+{
+  if (hart_threads.empty())
+    return;
+  hart_threads_exit = true;
+  quantum_start->arrive_and_wait();
+  for (auto& t : hart_threads)
+    t.join();
+  hart_threads.clear();
+}
+
+// Checkpoints hold the hart, memory and device state, in this order. The
+// devices save their own state (abstract_device_t::save_state), which is
+// enough for the CLINT, PLIC and UART. The state of HTIF devices (e.g. the
+// syscall proxy) and of the trigger module is not saved.
+static const char checkpoint_magic[] = "g4trace-checkpoint-v1";
+
+void sim_t::set_checkpoint_at_roi(const std::string& dir)
+{
+  checkpoint_dir = dir;
+  for (processor_t *proc : procs)
+    proc->set_stop_at_start_tracing(true);
+}
+
+void sim_t::save_checkpoint()
+{
+  std::filesystem::create_directories(checkpoint_dir);
+  auto filename = checkpoint_dir + "/checkpoint";
+  std::ofstream o(filename, std::ios::binary);
+
+  checkpoint_put(o, checkpoint_magic);
+  checkpoint_put(o, procs.size());
+  checkpoint_put(o, mems.size());
+  checkpoint_put(o, devices.size());
+  checkpoint_put(o, current_step);
+  checkpoint_put(o, current_proc);
+  for (processor_t *proc : procs)
+    proc->save_state(o);
+  for (auto& [base, mem] : mems) {
+    checkpoint_put(o, base);
+    mem->save_state(o);
+  }
+  for (auto& dev : devices)
+    dev->save_state(o);
+
+  if (!o.flush()) {
+    fprintf(stderr, "Error: cannot write checkpoint '%s'\n", filename.c_str());
+    exit(1);
+  }
+  fprintf(stderr, "Saved checkpoint '%s'\n", filename.c_str());
+}
+
+void sim_t::restore_checkpoint()
+{
+  auto filename = restore_dir + "/checkpoint";
+  std::ifstream i(filename, std::ios::binary);
+  if (!i) {
+    fprintf(stderr, "Error: cannot open checkpoint '%s'\n", filename.c_str());
+    exit(1);
+  }
+
+  try {
+    char magic[sizeof(checkpoint_magic)];
+    checkpoint_get(i, magic);
+    if (memcmp(magic, checkpoint_magic, sizeof(magic)) != 0)
+      throw std::runtime_error("not a checkpoint");
+    checkpoint_check(i, procs.size(), "number of harts");
+    checkpoint_check(i, mems.size(), "memory configuration");
+    checkpoint_check(i, devices.size(), "device configuration");
+    checkpoint_get(i, current_step);
+    checkpoint_get(i, current_proc);
+    for (processor_t *proc : procs)
+      proc->restore_state(i);
+    for (auto& [base, mem] : mems) {
+      checkpoint_check(i, base, "memory configuration");
+      mem->restore_state(i);
+    }
+    for (auto& dev : devices)
+      dev->restore_state(i);
+    if (i.peek() != EOF)
+      throw std::runtime_error("checkpoint has trailing data");
+  } catch (std::runtime_error& e) {
+    fprintf(stderr, "Error: cannot restore checkpoint '%s': %s\n", filename.c_str(), e.what());
+    exit(1);
   }
 }
 
@@ -356,6 +534,9 @@ bool sim_t::mmio_load(reg_t paddr, size_t len, uint8_t* bytes)
 {
   if (paddr + len < paddr || !paddr_ok(paddr + len - 1))
     return false;
+  std::unique_lock<std::mutex> guard(mmio_lock, std::defer_lock);
+  if (nthreads > 1)
+    guard.lock();
   return bus.load(paddr, len, bytes);
 }
 
@@ -363,6 +544,9 @@ bool sim_t::mmio_store(reg_t paddr, size_t len, const uint8_t* bytes)
 {
   if (paddr + len < paddr || !paddr_ok(paddr + len - 1))
     return false;
+  std::unique_lock<std::mutex> guard(mmio_lock, std::defer_lock);
+  if (nthreads > 1)
+    guard.lock();
   return bus.store(paddr, len, bytes);
 }
 
@@ -431,6 +615,9 @@ void sim_t::reset()
 {
   if (dtb_enabled)
     set_rom();
+
+  if (!restore_dir.empty())
+    restore_checkpoint();
 }
 
 void sim_t::idle()
@@ -441,17 +628,26 @@ void sim_t::idle()
   if (debug || ctrlc_pressed)
     interactive();
   else {
+    // With several threads, every hart runs INTERLEAVE instructions per call
+    // (and the instruction limit is shared equally among them)
+    size_t quantum = nthreads > 1 ? INTERLEAVE * procs.size() : INTERLEAVE;
+    auto step_quantum = [this](size_t n) {
+      if (nthreads > 1)
+        step_parallel(n / procs.size());
+      else
+        step(n);
+    };
     if (instruction_limit.has_value()) {
-      if (*instruction_limit < INTERLEAVE) {
+      if (*instruction_limit < quantum) {
         // Final step.
-        step(*instruction_limit);
+        step_quantum(*instruction_limit);
         htif_exit(0);
         *instruction_limit = 0;
         return;
       }
-      *instruction_limit -= INTERLEAVE;
+      *instruction_limit -= quantum;
     }
-    step(INTERLEAVE);
+    step_quantum(quantum);
   }
 
   if (remote_bitbang)
@@ -12,10 +12,14 @@
 #include "simif.h"
 
 #include <fesvr/htif.h>
+#include <barrier>
+#include <exception>
 #include <vector>
 #include <map>
+#include <mutex>
 #include <string>
 #include <memory>
+#include <thread>
 #include <sys/types.h>
 
 class mmu_t;
@@ -51,6 +55,25 @@ public:
   // enable_commitlog is true, so will the commit results
   void configure_log(bool enable_log, bool enable_commitlog, G4TraceConfig* g4trace_config);
 
+  // Run until a hart reaches the START_TRACING hint, save a checkpoint in dir
+  // and exit (--g4trace-checkpoint-at-roi)
+  void set_checkpoint_at_roi(const std::string& dir);
+  // Resume from the checkpoint in dir (--restore)
+  void set_restore(const std::string& dir) { restore_dir = dir; }
+
+  // Simulate the harts concurrently on n host threads (--threads). Each
+  // thread runs its harts for INTERLEAVE instructions, then all of them wait
+  // at a barrier, where reservations are yielded and devices are ticked.
+  void set_threads(size_t n);
+
+  // Translate hot straight-line code into host code (--jit, see jit.h)
+  void set_jit(bool enable);
+
+  // Size of the harts' TLBs (--tlb-entries) and printing their counters
+  // at exit (--tlb-stats)
+  void set_tlb_entries(size_t n);
+  void set_tlb_stats(bool enable);
+
   void set_procs_debug(bool value);
   void set_remote_bitbang(remote_bitbang_t* remote_bitbang) {
     this->remote_bitbang = remote_bitbang;
@@ -90,6 +113,24 @@ private:
 
   std::optional<unsigned long long> instruction_limit;
 
+  std::string checkpoint_dir;
+  std::string restore_dir;
+  void save_checkpoint();
+  void restore_checkpoint();
+
+  size_t nthreads = 1;
+  std::vector<std::thread> hart_threads; // nthreads - 1, the main thread runs harts too
+  std::unique_ptr<std::barrier<>> quantum_start;
+  std::unique_ptr<std::barrier<>> quantum_end;
+  size_t quantum_steps = 0;
+  bool hart_threads_exit = false;
+  std::vector<std::exception_ptr> hart_thread_errors;
+  std::mutex mmio_lock; // serializes device accesses from the hart threads
+  void step_parallel(size_t n); // step every hart n instructions
+  void step_harts(size_t thread);
+  void hart_thread_main(size_t thread);
+  void stop_hart_threads();
+
   socketif_t *socketif;
   std::ostream sout_; // used for socket and terminal interface
 
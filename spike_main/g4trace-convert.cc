@@ -0,0 +1,90 @@
+// See LICENSE for license details.
+
+// Converts binary gems4proc traces (spike --log-g4trace-format=binary) to the
+// text .trc format read by gems4proc.
+//
+//   g4trace-convert [--compression=C] trace-0000.trcb trace-0000.trc
+//   g4trace-convert [--compression=C] binary-trace-dir text-trace-dir
+//
+// When given directories, every trace-NNNN.trcb is converted and trace.index
+// is copied, so the result can be used as if it had been traced as text.
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "fesvr/option_parser.h"
+#include "common.h"
+#include "g4trace.h"
+
+using namespace std;
+
+static void help(int exit_code = 1)
+{
+  fprintf(stderr, "usage: g4trace-convert [--compression=C] <input> <output>\n");
+  fprintf(stderr, "  <input> and <output> are either trace files or trace directories\n");
+  fprintf(stderr, "  --compression=C   Output compression (lzma, zstd, none, lzma-3, zstd-13, …) [default %s]\n",
+          G4TraceConfig().compression.c_str());
+  exit(exit_code);
+}
+
+static bool convert_file(const filesystem::path& input, const filesystem::path& output, const string& compression)
+{
+  unique_ptr<istream> in(g4trace_open_compressed_istream(input));
+  if (!in) {
+    fprintf(stderr, "Unable to open '%s'\n", input.c_str());
+    return false;
+  }
+  unique_ptr<ostream> out(g4trace_open_compressed_ostream(output, compression));
+  if (!g4trace_convert_binary_to_text(*in, *out)) {
+    fprintf(stderr, "Error converting '%s': truncated or corrupt trace\n", input.c_str());
+    return false;
+  }
+  out->flush();
+  return true;
+}
+
+int main(int UNUSED argc, char** argv)
+{
+  string compression = G4TraceConfig().compression;
+
+  option_parser_t parser;
+  parser.help([]{ help(); });
+  parser.option('h', "help", 0, [&](const char UNUSED *s){help(0);});
+  parser.option(0, "compression", 1, [&](const char* s){
+    string method;
+    int preset;
+    if (!g4trace_parse_compression_config(s, method, preset)) {
+      fprintf(stderr, "Invalid compression config '%s'\n", s);
+      exit(1);
+    }
+    compression = s;
+  });
+  auto args = parser.parse(argv);
+  if (!args[0] || !args[1] || args[2])
+    help();
+
+  filesystem::path input(args[0]), output(args[1]);
+
+  if (!filesystem::is_directory(input))
+    return convert_file(input, output, compression) ? 0 : 1;
+
+  if (filesystem::exists(output)) {
+    fprintf(stderr, "Error: '%s' already exists.\n", output.c_str());
+    return 1;
+  }
+  filesystem::create_directory(output);
+
+  bool ok = true;
+  for (const auto& entry : filesystem::directory_iterator(input)) {
+    auto name = entry.path().filename();
+    if (name == "trace.index") {
+      filesystem::copy_file(entry.path(), output / name);
+    } else if (name.extension() == ".trcb") {
+      ok = convert_file(entry.path(), output / name.replace_extension(".trc"), compression) && ok;
+    }
+  }
+  return ok ? 0 : 1;
+}
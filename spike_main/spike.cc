@@ -7,6 +7,7 @@
 #include "arith.h"
 #include "remote_bitbang.h"
 #include "cachesim.h"
+#include "jit.h"
 #include "extension.h"
 #include <dlfcn.h>
 #include <fesvr/option_parser.h>
@@ -31,6 +32,11 @@ static void help(int exit_code = 1)
   fprintf(stderr, "usage: spike [host options] <target program> [target options]\n");
   fprintf(stderr, "Host Options:\n");
   fprintf(stderr, "  -p<n>                 Simulate <n> processors [default 1]\n");
+  fprintf(stderr, "  --threads=<n>         Simulate the processors concurrently on <n> host threads [default 1]\n");
+  fprintf(stderr, "  --jit                 Translate hot integer code into host code (x86-64 hosts)\n");
+  fprintf(stderr, "  --tlb-entries=<n>     Entries in each of the simulator's fetch, load and store TLBs,\n");
+  fprintf(stderr, "                          a power of 2 [default 256]\n");
+  fprintf(stderr, "  --tlb-stats           Print TLB hit, miss and flush counters at exit\n");
   fprintf(stderr, "  -m<n>                 Provide <n> MiB of target memory [default 2048]\n");
   fprintf(stderr, "  -m<a:m,b:n,...>       Provide memory regions of size m and n bytes\n");
   fprintf(stderr, "                          at base addresses a and b (with 4 KiB alignment)\n");
@@ -64,6 +70,12 @@ static void help(int exit_code = 1)
   fprintf(stderr, "  --log-g4trace-max-instructions N    Stop tracing after N instructions (per processor)\n");
   fprintf(stderr, "  --log-g4trace-debug   TODO\n");
   fprintf(stderr, "  --log-g4trace-compression C         Compression configuration (lzma, zstd, none, lzma-3, zstd-13, …)\n");
+  fprintf(stderr, "  --log-g4trace-format F              Trace format: text [default] or binary (convert with g4trace-convert)\n");
+  fprintf(stderr, "  --log-g4trace-compress-threads N    Compress traces in N background threads [default 0, inline]\n");
+  fprintf(stderr, "  --log-g4trace-frame-instructions N  Start a new seekable trace frame every N instructions [default 1000000]\n");
+  fprintf(stderr, "  --log-g4trace-writer-threads        Format and write each trace on its own thread\n");
+  fprintf(stderr, "  --g4trace-checkpoint-at-roi=<dir>   Save a checkpoint in <dir> and exit when a hart reaches START_TRACING\n");
+  fprintf(stderr, "  --restore=<dir>       Resume from the checkpoint in <dir> (same program and options)\n");
   fprintf(stderr, "  --extension=<name>    Specify RoCC Extension\n");
   fprintf(stderr, "                          This flag can be used multiple times.\n");
   fprintf(stderr, "  --extlib=<name>       Shared library to load\n");
@@ -351,6 +363,10 @@ int main(int argc, char** argv)
   std::optional<unsigned long long> instructions;
   debug_module_config_t dm_config;
   cfg_arg_t<size_t> nprocs(1);
+  size_t threads = 1;
+  bool jit = false;
+  size_t tlb_entries = 0;
+  bool tlb_stats = false;
 
   cfg_t cfg;
 
@@ -385,6 +401,10 @@ int main(int argc, char** argv)
   parser.option('s', 0, 0, [&](const char UNUSED *s){socket = true;});
 #endif
   parser.option('p', 0, 1, [&](const char* s){nprocs = atoul_nonzero_safe(s);});
+  parser.option(0, "threads", 1, [&](const char* s){threads = atoul_nonzero_safe(s);});
+  parser.option(0, "jit", 0, [&](const char UNUSED *s){jit = true;});
+  parser.option(0, "tlb-entries", 1, [&](const char* s){tlb_entries = atoul_nonzero_safe(s);});
+  parser.option(0, "tlb-stats", 0, [&](const char UNUSED *s){tlb_stats = true;});
   parser.option('m', 0, 1, [&](const char* s){cfg.mem_layout = parse_mem_layout(s);});
   parser.option(0, "halted", 0, [&](const char UNUSED *s){halted = true;});
   parser.option(0, "rbb-port", 1, [&](const char* s){use_rbb = true; rbb_port = atoul_safe(s);});
@@ -462,6 +482,23 @@ int main(int argc, char** argv)
                     g4trace_config.compression = s;
                   }
                 });
+  parser.option(0, "log-g4trace-format", 1,
+                [&](const char* s){
+                  if (!g4trace_parse_format(s, g4trace_config.format)) {
+                    fprintf(stderr, "Invalid trace format '%s'. Valid values are 'text' and 'binary'\n", s);
+                    exit(-1);
+                  }
+                });
+  parser.option(0, "log-g4trace-compress-threads", 1,
+                [&](const char* s){g4trace_config.compress_threads = atoul_safe(s);});
+  parser.option(0, "log-g4trace-frame-instructions", 1,
+                [&](const char* s){g4trace_config.frame_instructions = atoul_safe(s);});
+  parser.option(0, "log-g4trace-writer-threads", 0,
+                [&](const char UNUSED *s){g4trace_config.writer_threads = true;});
+  const char* checkpoint_dir = nullptr;
+  const char* restore_dir = nullptr;
+  parser.option(0, "g4trace-checkpoint-at-roi", 1, [&](const char* s){checkpoint_dir = s;});
+  parser.option(0, "restore", 1, [&](const char* s){restore_dir = s;});
   FILE *cmd_file = NULL;
   parser.option(0, "debug-cmd", 1, [&](const char* s){
      if ((cmd_file = fopen(s, "r"))==NULL) {
@@ -592,6 +629,43 @@ int main(int argc, char** argv)
     }
   }
 
+  if (checkpoint_dir) {
+    if (std::filesystem::exists(std::string(checkpoint_dir) + "/checkpoint")) {
+      fprintf(stderr, "Error: checkpoint '%s' already exists.\n", checkpoint_dir);
+      exit(-1);
+    }
+    s.set_checkpoint_at_roi(checkpoint_dir);
+  }
+  if (restore_dir)
+    s.set_restore(restore_dir);
+
+  if (threads > 1) {
+    // These share state between harts that is not synchronized
+    if (debug || use_rbb || log || log_commits || ic || dc || l2) {
+      fprintf(stderr, "Error: --threads cannot be used with -d, --rbb-port, -l, --log-commits, --ic, --dc or --l2\n");
+      exit(-1);
+    }
+    s.set_threads(threads);
+  }
+
+  if (jit) {
+    if (!jit_t::supported()) {
+      fprintf(stderr, "Error: --jit is not supported on this host\n");
+      exit(-1);
+    }
+    s.set_jit(true);
+  }
+
+  if (tlb_entries) {
+    if (tlb_entries & (tlb_entries - 1)) {
+      fprintf(stderr, "Error: --tlb-entries must be a power of 2\n");
+      exit(-1);
+    }
+    s.set_tlb_entries(tlb_entries);
+  }
+  if (tlb_stats)
+    s.set_tlb_stats(true);
+
   s.set_debug(debug);
   s.configure_log(log, log_commits, &g4trace_config);
   s.set_histogram(histogram);